@@ -3,6 +3,7 @@
 
 #include<stdint.h>
 #include<stdlib.h>
+#include<string.h>
 
 #define TAP(a) (((a) == 0) ? 0 : ((1ull) << (((uint64_t)(a)) - (1ull))))
 
@@ -26,4 +27,263 @@ inline static uint64_t RandLFSR(uint64_t * x) {
      return RandLFSR64(x);
 }
 
+// A random index in [0, n) from a random 64-bit x, without the 20-40
+// cycle divide that x % n costs: Lemire's multiply-shift, the high 64
+// bits of x * n.  It uses x's top bits, and its bias is at most
+// n / 2^64.
+inline static uint64_t RandRange(uint64_t x, uint64_t n) {
+     return static_cast<uint64_t>((static_cast<__uint128_t>(x) * n) >> 64);
+}
+
+// RandRange() for an n that's fixed during the run, with the method
+// picked once at setup: a mask when n is a power of two (which picks
+// the same indexes x % n always did), multiply-shift otherwise, or
+// x % n if asked (-modulo), to compare with the old way.
+struct RandBound {
+     enum Method {
+	  Mask,
+	  MultiplyShift,
+	  Modulo
+     };
+     Method method;
+     uint64_t n;
+     uint64_t mask;
+
+     RandBound() : method(Mask), n(1), mask(0) {}
+     explicit RandBound(uint64_t range, bool modulo = false) {Set(range, modulo);}
+
+     void Set(uint64_t range, bool modulo = false) {
+	  n = range > 0 ? range : 1;
+	  mask = n - 1;
+	  method = modulo ? Modulo : (n & mask) == 0 ? Mask : MultiplyShift;
+     }
+
+     inline uint64_t operator()(uint64_t x) const {
+	  switch (method) {
+	  case Mask:
+	       return x & mask;
+	  case MultiplyShift:
+	       return RandRange(x, n);
+	  default:
+	       return x % n;
+	  }
+     }
+};
+
+// Other generators, for when RandLFSR()'s quality isn't enough or to
+// see what a better one costs.  Each steps its state in place and
+// returns the next value.  None of them needs a nonzero seed except
+// xorshift128+ (which can't have both words 0; seed it with
+// RandSeedXorShift128Plus()) and xorshift64*.
+
+// splitmix64: a counter through a mixer.  Good on its own, and the
+// usual way to turn one seed into several uncorrelated ones.
+inline static uint64_t SplitMix64(uint64_t *state) {
+     uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+     z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+     z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+     return z ^ (z >> 31);
+}
+
+// xorshift128+: two words of state, shifts, xors and an add.
+inline static uint64_t RandXorShift128Plus(uint64_t state[2]) {
+     uint64_t s1 = state[0];
+     const uint64_t s0 = state[1];
+     state[0] = s0;
+     s1 ^= s1 << 23;
+     state[1] = s1 ^ s0 ^ (s1 >> 18) ^ (s0 >> 5);
+     return state[1] + s0;
+}
+
+inline static void RandSeedXorShift128Plus(uint64_t state[2], uint64_t seed) {
+     state[0] = SplitMix64(&seed);
+     state[1] = SplitMix64(&seed) | 1;
+}
+
+// xorshift64*: one word of state (not 0), three shifts and a multiply.
+// Use it instead of RandLFSR() to pick things (ops, indexes, arrival
+// gaps) whose order matters: successive LFSR values are shifts of each
+// other, so one pick would tell you a lot about the next.
+inline static uint64_t RandXorShift64Star(uint64_t *state) {
+     *state ^= *state >> 12;
+     *state ^= *state << 25;
+     *state ^= *state >> 27;
+     return *state * 2685821657736338717ull;
+}
+
+// wyrand: a counter through one 64x64->128 bit multiply.
+inline static uint64_t RandWy(uint64_t *state) {
+     *state += 0xa0761d6478bd642full;
+     __uint128_t t = static_cast<__uint128_t>(*state) * (*state ^ 0xe7037ed1a0b428dbull);
+     return static_cast<uint64_t>(t >> 64) ^ static_cast<uint64_t>(t);
+}
+
+// Jump-ahead for RandLFSR64().  Each step is linear over GF(2), i.e.,
+// multiplying the seed by a 64x64 bit matrix, so n steps is one
+// multiply by that matrix to the n, built from its squares.  Costs a
+// few thousand xors, so it's for setup, not the timed part.
+struct RandLFSR64Powers {
+     // power[k][j] is column j of the step matrix to the 2^k.
+     uint64_t power[64][64];
+
+     static uint64_t Apply(const uint64_t m[64], uint64_t v) {
+	  uint64_t r = 0;
+	  for(int j = 0; v != 0; j++, v >>= 1) {
+	       r ^= m[j] & -(v & 1);
+	  }
+	  return r;
+     }
+
+     RandLFSR64Powers() {
+	  uint64_t seed = 1;
+	  RandLFSR64(&seed);
+	  power[0][0] = seed; // The taps.
+	  for(int j = 1; j < 64; j++) {
+	       power[0][j] = 1ull << (j - 1);
+	  }
+	  for(int k = 1; k < 64; k++) {
+	       for(int j = 0; j < 64; j++) {
+		    power[k][j] = Apply(power[k - 1], power[k - 1][j]);
+	       }
+	  }
+     }
+};
+
+// Move seed steps steps along the RandLFSR64() sequence.
+inline static void RandLFSR64Jump(uint64_t *seed, uint64_t steps) {
+     static const RandLFSR64Powers powers;
+     for(int k = 0; steps != 0; k++, steps >>= 1) {
+	  if (steps & 1) {
+	       *seed = RandLFSR64Powers::Apply(powers.power[k], *seed);
+	  }
+     }
+}
+
+// The seed of stream stream of seed: seed's place in the RandLFSR64()
+// sequence, moved stream << RAND_STREAM_BITS steps along.  Streams
+// don't overlap until one of them has made 2^RAND_STREAM_BITS calls
+// (days, even at a call per ns), and the same seed and stream always
+// give the same numbers.  Never 0, for any seed.
+#define RAND_STREAM_BITS 48
+
+inline static uint64_t RandStreamSeed(uint64_t seed, unsigned int stream) {
+     uint64_t s = SplitMix64(&seed);
+     if (s == 0) {
+	  s = 1;
+     }
+     RandLFSR64Jump(&s, static_cast<uint64_t>(stream) << RAND_STREAM_BITS);
+     return s;
+}
+
+// Batches.  RandLanes holds RAND_LANES independent copies of a
+// generator's state, and the ...Fill() functions step all of them
+// together to fill a buffer, lane by lane.  The lanes are a GCC vector
+// type, so the shift and xor generators (LFSR, xorshift128+) and
+// splitmix64 step every lane with a few vector instructions, and
+// wyrand's multiplies at least overlap.  On x86 with GCC each Fill()
+// is compiled for SSE2, AVX2 and AVX-512 and picks one when the
+// program loads.  n need not be a multiple of RAND_LANES; the last,
+// partial group still steps every lane and drops the values it
+// doesn't need.
+#define RAND_LANES 8
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define RAND_FILL_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define RAND_FILL_CLONES
+#endif
+
+typedef uint64_t RandVector __attribute__((vector_size(RAND_LANES * sizeof(uint64_t))));
+
+struct RandLanes {
+     uint64_t s0[RAND_LANES];
+     uint64_t s1[RAND_LANES];
+};
+
+// Lane l of an LFSR batch starts RAND_STREAM_BITS - 3 bits' worth of
+// steps after lane l - 1, so the lanes of one stream don't overlap
+// each other (or the next stream).  The others get seeds from
+// splitmix64.
+inline static void RandSeedLanes(RandLanes & lanes, uint64_t seed) {
+     uint64_t s = seed;
+     for(int l = 0; l < RAND_LANES; l++) {
+	  lanes.s0[l] = seed == 0 ? 1 : seed;
+	  RandLFSR64Jump(&lanes.s0[l], static_cast<uint64_t>(l) << (RAND_STREAM_BITS - 3));
+	  lanes.s1[l] = SplitMix64(&s) | 1;
+     }
+}
+
+// Fill() body: load the lanes into vectors, STEP() them once per
+// RAND_LANES outputs, then store them back.
+#define RAND_FILL_DECL(NAME, STEP)					\
+     RAND_FILL_CLONES							\
+     inline static void NAME(RandLanes & lanes, uint64_t * out, size_t n) { \
+	  RandVector s0;						\
+	  RandVector s1;						\
+	  RandVector v;							\
+	  memcpy(&s0, lanes.s0, sizeof(s0));				\
+	  memcpy(&s1, lanes.s1, sizeof(s1));				\
+	  size_t i = 0;							\
+	  for(; i + RAND_LANES <= n; i += RAND_LANES) {			\
+	       STEP(v, s0, s1);						\
+	       memcpy(out + i, &v, sizeof(v));				\
+	  }								\
+	  if (i < n) {							\
+	       STEP(v, s0, s1);						\
+	       memcpy(out + i, &v, (n - i) * sizeof(uint64_t));		\
+	  }								\
+	  memcpy(lanes.s0, &s0, sizeof(s0));				\
+	  memcpy(lanes.s1, &s1, sizeof(s1));				\
+     }
+
+#define RAND_LFSR64_STEP(OUT, S0, S1)					\
+     (S0) = ((S0) >> 1) ^ (-((S0) & 1) & (TAP(64) | TAP(63) | TAP(61) | TAP(60))); \
+     (OUT) = (S0);
+
+#define RAND_XORSHIFT128PLUS_STEP(OUT, S0, S1)				\
+     {									\
+	  RandVector x = (S0);						\
+	  const RandVector y = (S1);					\
+	  (S0) = y;							\
+	  x ^= x << 23;							\
+	  (S1) = x ^ y ^ (x >> 18) ^ (y >> 5);				\
+	  (OUT) = (S1) + y;						\
+     }
+
+#define RAND_SPLITMIX64_STEP(OUT, S0, S1)				\
+     {									\
+	  RandVector z = ((S1) += 0x9e3779b97f4a7c15ull);		\
+	  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;			\
+	  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;			\
+	  (OUT) = z ^ (z >> 31);					\
+     }
+
+// LFSR lanes use s0; the others use s1 (xorshift128+ uses both).
+RAND_FILL_DECL(RandLFSR64Fill, RAND_LFSR64_STEP);
+RAND_FILL_DECL(RandXorShift128PlusFill, RAND_XORSHIFT128PLUS_STEP);
+RAND_FILL_DECL(SplitMix64Fill, RAND_SPLITMIX64_STEP);
+
+// There's no vector 64x64->128 bit multiply, so wyrand steps its lanes
+// one by one, from plain arrays.  They're still independent, so the
+// multiplies overlap.
+inline static void RandWyFill(RandLanes & lanes, uint64_t * out, size_t n) {
+     uint64_t s1[RAND_LANES];
+     memcpy(s1, lanes.s1, sizeof(s1));
+     size_t i = 0;
+     for(; i + RAND_LANES <= n; i += RAND_LANES) {
+	  for(int l = 0; l < RAND_LANES; l++) {
+	       out[i + l] = RandWy(&s1[l]);
+	  }
+     }
+     if (i < n) {
+	  for(int l = 0; l < RAND_LANES; l++, i++) {
+	       uint64_t v = RandWy(&s1[l]);
+	       if (i < n) {
+		    out[i] = v;
+	       }
+	  }
+     }
+     memcpy(lanes.s1, s1, sizeof(s1));
+}
+
 #endif
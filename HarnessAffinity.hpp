@@ -0,0 +1,225 @@
+#ifndef HARNESS_AFFINITY_INCLUDED
+#define HARNESS_AFFINITY_INCLUDED
+
+#include <sched.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+namespace nvsl {
+     // Where a CPU sits in the machine, from /sys/devices/system/cpu.
+     // smt is this CPU's position among its core's hardware threads (0
+     // for the first sibling).
+     struct CpuInfo {
+	  int cpu;
+	  int package;
+	  int core;
+	  int smt;
+     };
+
+     inline static std::string ReadSysLine(const std::string & path) {
+	  char buf[4096] = "";
+	  FILE * f = fopen(path.c_str(), "r");
+	  if (f != NULL) {
+	       if (fgets(buf, sizeof(buf), f) == NULL) {
+		    buf[0] = 0;
+	       }
+	       fclose(f);
+	  }
+	  return buf;
+     }
+
+     inline static int ReadSysInt(const std::string & path, int otherwise) {
+	  FILE * f = fopen(path.c_str(), "r");
+	  if (f == NULL) {
+	       return otherwise;
+	  }
+	  int v = otherwise;
+	  if (fscanf(f, "%d", &v) != 1) {
+	       v = otherwise;
+	  }
+	  fclose(f);
+	  return v;
+     }
+
+     // Parse a Linux CPU/node list like "0-3,8,10-11".  Returns false if
+     // it doesn't parse.
+     inline static bool ParseCpuList(const std::string & list, std::vector<int> & out) {
+	  const char * p = list.c_str();
+	  while (*p) {
+	       char * end;
+	       long first = strtol(p, &end, 10);
+	       if (end == p || first < 0) {
+		    return false;
+	       }
+	       long last = first;
+	       p = end;
+	       if (*p == '-') {
+		    last = strtol(p + 1, &end, 10);
+		    if (end == p + 1 || last < first) {
+			 return false;
+		    }
+		    p = end;
+	       }
+	       for(long c = first; c <= last; c++) {
+		    out.push_back(c);
+	       }
+	       if (*p == ',') {
+		    p++;
+	       } else if (*p && *p != '\n') {
+		    return false;
+	       } else {
+		    break;
+	       }
+	  }
+	  return !out.empty();
+     }
+
+     // The CPUs this process may run on (which respects taskset and
+     // cgroups), with their topology.
+     static std::vector<CpuInfo> ReadTopology() {
+	  std::vector<CpuInfo> cpus;
+	  cpu_set_t allowed;
+	  CPU_ZERO(&allowed);
+	  sched_getaffinity(0, sizeof(allowed), &allowed);
+	  for(int c = 0; c < CPU_SETSIZE; c++) {
+	       if (!CPU_ISSET(c, &allowed)) {
+		    continue;
+	       }
+	       char dir[128];
+	       snprintf(dir, sizeof(dir), "/sys/devices/system/cpu/cpu%d/", c);
+	       CpuInfo info;
+	       info.cpu = c;
+	       info.package = ReadSysInt(std::string(dir) + "topology/physical_package_id", 0);
+	       info.core = ReadSysInt(std::string(dir) + "topology/core_id", c);
+	       info.smt = 0;
+	       cpus.push_back(info);
+	  }
+	  // Number the SMT siblings of each core in CPU order.
+	  for(unsigned int i = 0; i < cpus.size(); i++) {
+	       for(unsigned int j = 0; j < i; j++) {
+		    if (cpus[j].package == cpus[i].package && cpus[j].core == cpus[i].core) {
+			 cpus[i].smt++;
+		    }
+	       }
+	  }
+	  return cpus;
+     }
+
+     // Pinning policies.  Each returns the order to hand CPUs out in;
+     // thread i gets entry i (modulo the size).
+     //
+     //   compact:  fill a core's hardware threads, then the next core in
+     //             the same package, then the next package.
+     //   scatter:  spread threads across packages and then cores, so
+     //             each gets as much of the machine to itself as
+     //             possible.  SMT siblings come after every core has one.
+     //   smtlast:  one hardware thread per core in package order, and
+     //             SMT siblings only once every core has been used.
+     struct CompactOrder {
+	  bool operator()(const CpuInfo & a, const CpuInfo & b) const {
+	       if (a.package != b.package) return a.package < b.package;
+	       if (a.core != b.core) return a.core < b.core;
+	       return a.smt < b.smt;
+	  }
+     };
+
+     struct SmtLastOrder {
+	  bool operator()(const CpuInfo & a, const CpuInfo & b) const {
+	       if (a.smt != b.smt) return a.smt < b.smt;
+	       return CompactOrder()(a, b);
+	  }
+     };
+
+     static std::vector<int> CpuOrder(const std::string & policy) {
+	  std::vector<CpuInfo> cpus = ReadTopology();
+	  std::vector<int> order;
+	  if (policy == "compact") {
+	       std::sort(cpus.begin(), cpus.end(), CompactOrder());
+	  } else if (policy == "smtlast") {
+	       std::sort(cpus.begin(), cpus.end(), SmtLastOrder());
+	  } else if (policy == "scatter") {
+	       // Round robin over packages, taking each package's CPUs in
+	       // smtlast order.
+	       std::sort(cpus.begin(), cpus.end(), SmtLastOrder());
+	       std::vector<std::vector<int> > perPackage;
+	       std::vector<int> packages;
+	       for(unsigned int i = 0; i < cpus.size(); i++) {
+		    unsigned int p = std::find(packages.begin(), packages.end(), cpus[i].package) - packages.begin();
+		    if (p == packages.size()) {
+			 packages.push_back(cpus[i].package);
+			 perPackage.push_back(std::vector<int>());
+		    }
+		    perPackage[p].push_back(cpus[i].cpu);
+	       }
+	       for(unsigned int k = 0; order.size() < cpus.size(); k++) {
+		    for(unsigned int p = 0; p < perPackage.size(); p++) {
+			 if (k < perPackage[p].size()) {
+			      order.push_back(perPackage[p][k]);
+			 }
+		    }
+	       }
+	       return order;
+	  } else {
+	       ParseCpuList(policy, order);
+	       return order;
+	  }
+	  for(unsigned int i = 0; i < cpus.size(); i++) {
+	       order.push_back(cpus[i].cpu);
+	  }
+	  return order;
+     }
+
+     inline static bool PinToCpu(int cpu) {
+	  cpu_set_t set;
+	  CPU_ZERO(&set);
+	  CPU_SET(cpu, &set);
+	  return sched_setaffinity(0, sizeof(set), &set) == 0;
+     }
+
+     // NUMA memory policies for the calling thread.  There's no glibc
+     // wrapper for set_mempolicy(2) without libnuma, so call it directly.
+     //
+     //   local:       allocate on the node of the CPU that first touches
+     //                the page.
+     //   interleave:  spread pages round robin across all nodes.
+     //   <node>:      only allocate on that node.
+     static bool SetMemoryPolicy(const std::string & policy) {
+	  unsigned long mask = 0;
+	  const int bits = sizeof(mask) * 8;
+	  int mode;
+	  if (policy == "local") {
+	       mode = MPOL_LOCAL;
+	  } else if (policy == "interleave") {
+	       std::vector<int> nodes;
+	       if (!ParseCpuList(ReadSysLine("/sys/devices/system/node/has_memory"), nodes)) {
+		    nodes.push_back(0);
+	       }
+	       for(unsigned int i = 0; i < nodes.size(); i++) {
+		    if (nodes[i] < bits) {
+			 mask |= 1ul << nodes[i];
+		    }
+	       }
+	       mode = MPOL_INTERLEAVE;
+	  } else {
+	       char * end;
+	       long node = strtol(policy.c_str(), &end, 10);
+	       if (*end || end == policy.c_str() || node < 0 || node >= bits) {
+		    return false;
+	       }
+	       mask = 1ul << node;
+	       mode = MPOL_BIND;
+	  }
+	  // The kernel reads maxnode - 1 bits of the mask, so pass one more
+	  // than it has, or the last node could never be picked.
+	  return syscall(SYS_set_mempolicy, mode, mask ? &mask : NULL, mask ? bits + 1 : 0) == 0;
+     }
+}
+#endif
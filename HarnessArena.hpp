@@ -0,0 +1,86 @@
+#ifndef HARNESS_ARENA_INCLUDED
+#define HARNESS_ARENA_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string>
+
+// Older headers don't have the hugetlb size flags.
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace nvsl {
+     static const size_t CacheLineBytes = 64;
+
+     // What -pages can ask for.
+     //
+     //   4k:   ordinary pages.
+     //   thp:  ordinary pages, 2 MB aligned and madvise(MADV_HUGEPAGE)d
+     //         so the kernel backs them with transparent hugepages where
+     //         it can (see the thp field of the results).
+     //   2m:   2 MB hugetlbfs pages (MAP_HUGETLB).
+     //   1g:   1 GB hugetlbfs pages.
+     //
+     // hugetlbfs pages have to be reserved ahead of time (e.g., in
+     // /sys/kernel/mm/hugepages/hugepages-2048kB/nr_hugepages), or the
+     // mapping fails.
+     inline static bool IsPageKind(const std::string & pages) {
+	  return pages == "4k" || pages == "thp" || pages == "2m" || pages == "1g";
+     }
+
+     inline static size_t PageKindBytes(const std::string & pages) {
+	  if (pages == "1g") {
+	       return 1ul << 30;
+	  } else if (pages == "2m" || pages == "thp") {
+	       return 2ul << 20;
+	  }
+	  return sysconf(_SC_PAGESIZE);
+     }
+
+     // Map at least bytes of private anonymous memory backed by pages,
+     // rounded up to whole pages (mapped says how much).  The memory is
+     // zero but not faulted in yet.  Returns NULL on failure.
+     static void * MapPages(size_t bytes, const std::string & pages, size_t & mapped) {
+	  size_t page = PageKindBytes(pages);
+	  mapped = (bytes + page - 1) / page * page;
+	  if (mapped == 0) {
+	       mapped = page;
+	  }
+	  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	  if (pages == "2m") {
+	       flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+	  } else if (pages == "1g") {
+	       flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+	  }
+	  // mmap() only promises 4 KB alignment, and THP can only back the
+	  // 2 MB aligned parts, so map a page extra and trim.
+	  size_t slop = pages == "thp" ? page : 0;
+	  void * p = mmap(NULL, mapped + slop, PROT_READ | PROT_WRITE, flags, -1, 0);
+	  if (p == MAP_FAILED) {
+	       return NULL;
+	  }
+	  if (slop) {
+	       uintptr_t start = reinterpret_cast<uintptr_t>(p);
+	       uintptr_t aligned = (start + page - 1) / page * page;
+	       if (aligned > start) {
+		    munmap(p, aligned - start);
+	       }
+	       if (start + slop > aligned) {
+		    munmap(reinterpret_cast<void *>(aligned + mapped), start + slop - aligned);
+	       }
+	       p = reinterpret_cast<void *>(aligned);
+	       madvise(p, mapped, MADV_HUGEPAGE);
+	  }
+	  return p;
+     }
+}
+#endif
@@ -2,6 +2,68 @@
 #define HARNESS_BARRIER_INCLUDED
 
 #include<cassert>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "AtomicOps.hpp"
+
+namespace nvsl {
+     // A sense-reversing spin barrier.  The arrival count and the sense
+     // are on their own cache lines, so waiters spin on a line that
+     // only changes once, when the last thread flips the sense, and
+     // they all see it within a cache miss of each other.  That makes
+     // the threads leave much closer together than a condition
+     // variable does.
+     //
+     // Spinning needs a CPU per thread, so after spinLimit tries a
+     // waiter sleeps on a futex instead (spinLimit = 0 always sleeps,
+     // and the default never does).
+     class SpinBarrier {
+	  volatile int _count __attribute__((aligned(64)));
+	  volatile int _sense __attribute__((aligned(64)));
+	  volatile int _sleepers;
+	  int _numThreads __attribute__((aligned(64)));
+	  unsigned long _spinLimit;
+
+	  static void Pause() {
+#if defined(__x86_64__) || defined(__i386__)
+	       __asm__ __volatile__ ("pause" ::: "memory");
+#endif
+	  }
+
+     public:
+	  SpinBarrier(int count, unsigned long spinLimit = ULONG_MAX) :
+	       _count(0), _sense(0), _sleepers(0), _numThreads(count), _spinLimit(spinLimit) {}
+
+	  void Join() {
+	       // The sense can't flip until we arrive, so reading it
+	       // first is safe.
+	       int sense = !_sense;
+	       if (atomic_exchange_and_add(&_count, 1) == _numThreads - 1) {
+		    _count = 0;
+		    MemoryBarrier();
+		    _sense = sense;
+		    // So we can't miss a waiter that is just going to sleep.
+		    MemoryBarrier();
+		    if (_sleepers) {
+			 syscall(SYS_futex, &_sense, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+		    }
+		    return;
+	       }
+	       for(unsigned long spins = 0; _sense != sense; spins++) {
+		    if (spins < _spinLimit) {
+			 Pause();
+			 continue;
+		    }
+		    atomic_exchange_and_add(&_sleepers, 1);
+		    // Returns right away if the sense already flipped.
+		    syscall(SYS_futex, &_sense, FUTEX_WAIT_PRIVATE, !sense, NULL, NULL, 0);
+		    atomic_exchange_and_add(&_sleepers, -1);
+	       }
+	  }
+     };
+}
 
 #ifdef NO_BARRIERS
 
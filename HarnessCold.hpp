@@ -0,0 +1,102 @@
+#ifndef HARNESS_COLD_INCLUDED
+#define HARNESS_COLD_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include "HarnessArena.hpp"
+
+namespace nvsl {
+     // What -cold can do before each trial.
+     //
+     //   clflush:  flush the footprint (and any other registered memory)
+     //             out of every core's caches.
+     //   evict:    read through a buffer twice the size of the LLC, which
+     //             pushes everything else out of the caches and the TLB
+     //             of the core doing the reading.
+     //   drop:     drop registered files from the page cache, and all
+     //             clean page, dentry and inode caches if we may write
+     //             /proc/sys/vm/drop_caches (i.e., as root).
+     inline static bool IsColdStrategy(const std::string & how) {
+	  return how == "clflush" || how == "evict" || how == "drop";
+     }
+
+     // Flush [p, p + bytes) to memory and out of the caches.
+     static void FlushRange(const void * p, size_t bytes) {
+#if defined(__x86_64__) || defined(__i386__)
+	  const char * line = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(p) & ~(CacheLineBytes - 1));
+	  const char * end = reinterpret_cast<const char *>(p) + bytes;
+	  for(; line < end; line += CacheLineBytes) {
+	       __asm__ __volatile__ ("clflush %0" : "+m" (*const_cast<volatile char *>(line)));
+	  }
+	  __asm__ __volatile__ ("mfence" ::: "memory");
+#else
+	  (void)p;
+	  (void)bytes;
+#endif
+     }
+
+     // The size of the largest cache, from sysconf() or, where that
+     // doesn't know, sysfs.  0 if neither does.
+     static size_t LastLevelCacheBytes() {
+	  long bytes = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	  bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	  if (bytes <= 0) {
+	       bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	  }
+#endif
+	  for(int index = 3; bytes <= 0 && index >= 0; index--) {
+	       char path[64];
+	       snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+	       FILE * f = fopen(path, "r");
+	       if (f == NULL) {
+		    continue;
+	       }
+	       char unit = 0;
+	       if (fscanf(f, "%ld%c", &bytes, &unit) >= 1) {
+		    bytes *= unit == 'M' ? 1024 * 1024 : unit == 'K' ? 1024 : 1;
+	       }
+	       fclose(f);
+	  }
+	  return bytes > 0 ? bytes : 0;
+     }
+
+     // Read one word from every line of buffer.  The buffer has to have
+     // been written (untouched anonymous memory is all one zero page).
+     static void ReadThrough(const void * buffer, size_t bytes) {
+	  const volatile uint64_t * words = reinterpret_cast<const volatile uint64_t *>(buffer);
+	  for(size_t i = 0; i < bytes / sizeof(uint64_t); i += CacheLineBytes / sizeof(uint64_t)) {
+	       words[i];
+	  }
+     }
+
+     // Write back and drop file's cached pages.  Returns false if it
+     // can't be opened.
+     static bool DropFileCache(const std::string & file) {
+	  int fd = open(file.c_str(), O_RDONLY);
+	  if (fd < 0) {
+	       return false;
+	  }
+	  fdatasync(fd);
+	  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	  close(fd);
+	  return true;
+     }
+
+     // Drop the clean page cache and the dentry and inode caches.
+     // Returns false if we aren't allowed to.
+     static bool DropAllCaches() {
+	  sync();
+	  FILE * f = fopen("/proc/sys/vm/drop_caches", "w");
+	  if (f == NULL) {
+	       return false;
+	  }
+	  bool ok = fputs("3\n", f) >= 0;
+	  return fclose(f) == 0 && ok;
+     }
+}
+#endif
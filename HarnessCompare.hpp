@@ -0,0 +1,268 @@
+#ifndef HARNESS_COMPARE_INCLUDED
+#define HARNESS_COMPARE_INCLUDED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include "HarnessStats.hpp"
+
+namespace nvsl {
+     // One line of results, by field name, as read back from a file.
+     typedef std::map<std::string, std::string> ResultRow;
+
+     // Split a tsv (sep '\t') or csv (sep ',') line.  csv fields may be
+     // quoted, with "" for a quote, as ResultRecord writes them.
+     static std::vector<std::string> SplitResultLine(const std::string & line, char sep) {
+	  std::vector<std::string> fields;
+	  std::string field;
+	  bool quoted = false;
+	  for(unsigned int i = 0; i < line.size(); i++) {
+	       char c = line[i];
+	       if (quoted) {
+		    if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+			 field += '"';
+			 i++;
+		    } else if (c == '"') {
+			 quoted = false;
+		    } else {
+			 field += c;
+		    }
+	       } else if (c == '"' && sep == ',' && field.empty()) {
+		    quoted = true;
+	       } else if (c == sep) {
+		    fields.push_back(field);
+		    field.clear();
+	       } else if (c != '\r') {
+		    field += c;
+	       }
+	  }
+	  fields.push_back(field);
+	  return fields;
+     }
+
+     // Parse one of the flat JSON objects ResultRecord writes.  Strings
+     // are unescaped (\u escapes past ASCII become '?'), and numbers
+     // and null are kept as they're written.
+     static bool ParseResultJson(const std::string & line, ResultRow & row) {
+	  unsigned int i = 0;
+	  struct Parser {
+	       const std::string & s;
+	       unsigned int & i;
+	       void Skip() {
+		    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r')) {
+			 i++;
+		    }
+	       }
+	       bool String(std::string & out) {
+		    Skip();
+		    if (i >= s.size() || s[i] != '"') {
+			 return false;
+		    }
+		    for(i++; i < s.size() && s[i] != '"'; i++) {
+			 if (s[i] != '\\') {
+			      out += s[i];
+			      continue;
+			 }
+			 if (++i >= s.size()) {
+			      return false;
+			 }
+			 char c = s[i];
+			 if (c == 'u' && i + 4 < s.size()) {
+			      unsigned long u = strtoul(s.substr(i + 1, 4).c_str(), NULL, 16);
+			      out += u < 0x80 ? static_cast<char>(u) : '?';
+			      i += 4;
+			 } else {
+			      out += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+			 }
+		    }
+		    return i++ < s.size();
+	       }
+	  } p = {line, i};
+	  p.Skip();
+	  if (i >= line.size() || line[i++] != '{') {
+	       return false;
+	  }
+	  while (true) {
+	       p.Skip();
+	       if (i < line.size() && line[i] == '}') {
+		    return true;
+	       }
+	       std::string name;
+	       std::string value;
+	       if (!p.String(name)) {
+		    return false;
+	       }
+	       p.Skip();
+	       if (i >= line.size() || line[i++] != ':') {
+		    return false;
+	       }
+	       p.Skip();
+	       if (i < line.size() && line[i] == '"') {
+		    if (!p.String(value)) {
+			 return false;
+		    }
+	       } else {
+		    while (i < line.size() && line[i] != ',' && line[i] != '}' && line[i] != ' ') {
+			 value += line[i++];
+		    }
+	       }
+	       row[name] = value;
+	       p.Skip();
+	       if (i < line.size() && line[i] == ',') {
+		    i++;
+	       }
+	  }
+     }
+
+     // Read a results file in any -format (tsv, csv or json lines).
+     // Header lines may repeat, e.g., when several runs' stdout was
+     // concatenated.  Returns false if the file can't be read.
+     static bool ReadResults(const std::string & file, std::vector<ResultRow> & rows) {
+	  std::ifstream in(file.c_str());
+	  if (!in) {
+	       return false;
+	  }
+	  std::string line;
+	  std::vector<std::string> header;
+	  char sep = '\t';
+	  while (std::getline(in, line)) {
+	       if (line.empty()) {
+		    continue;
+	       }
+	       if (line[0] == '{') {
+		    ResultRow row;
+		    if (ParseResultJson(line, row)) {
+			 rows.push_back(row);
+		    }
+		    continue;
+	       }
+	       if (!line.compare(0, 5, "Bench")) {
+		    sep = line.find('\t') != std::string::npos ? '\t' : ',';
+		    header = SplitResultLine(line, sep);
+		    continue;
+	       }
+	       std::vector<std::string> fields = SplitResultLine(line, sep);
+	       ResultRow row;
+	       for(unsigned int i = 0; i < fields.size() && i < header.size(); i++) {
+		    row[header[i]] = fields[i];
+	       }
+	       if (!row.empty()) {
+		    rows.push_back(row);
+	       }
+	  }
+	  return true;
+     }
+
+     inline static std::string ResultField(const ResultRow & row, const std::string & name) {
+	  ResultRow::const_iterator f = row.find(name);
+	  return f == row.end() ? "" : f->second;
+     }
+
+     // Rows are the same configuration if they have the same Bench,
+     // Config and Threads, and footB and rate too (so the points of a
+     // sweep are told apart), and the same Phase (empty for the whole
+     // run, or in files from before there were phases).
+     static std::string ResultKey(const ResultRow & row) {
+	  std::string phase = ResultField(row, "Phase");
+	  return ResultField(row, "Bench") + " " + ResultField(row, "Config") +
+	       " threads=" + ResultField(row, "Threads") +
+	       " footB=" + ResultField(row, "footB") +
+	       " rate=" + ResultField(row, "rate") +
+	       (phase.empty() ? "" : " phase=" + phase);
+     }
+
+     // Whether row can be compared at all.  The whole-run row of a
+     // benchmark with phases leaves its trial statistics empty, since
+     // its trials are of different workloads; its phases' rows are
+     // compared instead.  Files from before there were trials have no
+     // Trials field, and are compared by opsPerSec.
+     static bool IsComparable(const ResultRow & row) {
+	  ResultRow::const_iterator f = row.find("Trials");
+	  return f == row.end() || !f->second.empty();
+     }
+
+     // The last row in baseline for the same configuration as row (a
+     // file that was appended to has the newest run last), or NULL.
+     static const ResultRow * FindBaseline(const std::vector<ResultRow> & baseline, const ResultRow & row) {
+	  std::string key = ResultKey(row);
+	  for(unsigned int i = baseline.size(); i > 0; i--) {
+	       if (ResultKey(baseline[i - 1]) == key) {
+		    return &baseline[i - 1];
+	       }
+	  }
+	  return NULL;
+     }
+
+     // One configuration, before and after.  Throughput is the mean of
+     // the trials, compared with Welch's t-test (unequal variances),
+     // which only needs the mean, standard deviation and count that
+     // every result already has.  With fewer than two trials on either
+     // side there's nothing to test, and the change alone decides.
+     struct Comparison {
+	  std::string key;
+	  double before;
+	  double after;
+	  double changePct;
+	  double t;
+	  double dof;
+	  bool tested;
+	  bool significant;
+	  // -1 for a regression past the threshold, 1 for a speedup past
+	  // it, 0 otherwise.
+	  int verdict;
+     };
+
+     static Comparison CompareResults(const ResultRow & before, const ResultRow & after, double thresholdPct) {
+	  Comparison c;
+	  c.key = ResultKey(after);
+	  double n1 = atof(ResultField(before, "Trials").c_str());
+	  double n2 = atof(ResultField(after, "Trials").c_str());
+	  c.tested = n1 >= 2 && n2 >= 2;
+	  c.before = atof(ResultField(before, c.tested ? "meanOpsPerSec" : "opsPerSec").c_str());
+	  c.after = atof(ResultField(after, c.tested ? "meanOpsPerSec" : "opsPerSec").c_str());
+	  c.changePct = c.before > 0 ? 100 * (c.after - c.before) / c.before : 0;
+	  c.t = 0;
+	  c.dof = 0;
+	  c.significant = false;
+	  if (c.tested) {
+	       double s1 = atof(ResultField(before, "sdOpsPerSec").c_str());
+	       double s2 = atof(ResultField(after, "sdOpsPerSec").c_str());
+	       double a = s1 * s1 / n1;
+	       double b = s2 * s2 / n2;
+	       if (a + b > 0) {
+		    c.t = (c.after - c.before) / sqrt(a + b);
+		    c.dof = (a + b) * (a + b) / (a * a / (n1 - 1) + b * b / (n2 - 1));
+		    c.significant = fabs(c.t) > SampleStats::T95(std::max(1.0, floor(c.dof)));
+	       } else {
+		    c.significant = c.after != c.before;
+	       }
+	  }
+	  bool counts = c.significant || !c.tested;
+	  c.verdict = 0;
+	  if (counts && c.changePct < -thresholdPct) {
+	       c.verdict = -1;
+	  } else if (counts && c.changePct > thresholdPct) {
+	       c.verdict = 1;
+	  }
+	  return c;
+     }
+
+     static std::string DescribeComparison(const Comparison & c) {
+	  std::ostringstream s;
+	  s << (c.verdict < 0 ? "REGRESSION " : c.verdict > 0 ? "faster     " : "same       ")
+	    << c.key << ": " << c.before << " -> " << c.after << " ops/sec ("
+	    << (c.changePct >= 0 ? "+" : "") << c.changePct << "%, ";
+	  if (c.tested) {
+	       s << "Welch t=" << c.t << " dof=" << c.dof << (c.significant ? ", significant" : ", not significant") << ")";
+	  } else {
+	       s << "too few trials to test)";
+	  }
+	  return s.str();
+     }
+}
+#endif
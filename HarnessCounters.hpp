@@ -0,0 +1,143 @@
+#ifndef HARNESS_COUNTERS_INCLUDED
+#define HARNESS_COUNTERS_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <vector>
+#include <string>
+
+namespace nvsl {
+     // Map a perf-style event name (as in `perf list`) to what
+     // perf_event_open(2) wants.  Returns false for names we don't know.
+     static bool LookupPerfEvent(const std::string & name, uint32_t & type, uint64_t & config) {
+	  struct Event {
+	       const char * name;
+	       uint32_t type;
+	       uint64_t config;
+	  };
+#define NVSL_CACHE_EVENT(cache, op, result) \
+	  ((cache) | ((op) << 8) | ((result) << 16))
+	  static const Event events[] = {
+	       {"cycles",                  PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	       {"instructions",            PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	       {"ref-cycles",              PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES},
+	       {"cache-references",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+	       {"cache-misses",            PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	       {"branches",                PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+	       {"branch-misses",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	       {"stalled-cycles-frontend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+	       {"stalled-cycles-backend",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+	       {"L1-dcache-loads",         PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	       {"L1-dcache-load-misses",   PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"LLC-loads",               PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	       {"LLC-misses",              PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"LLC-load-misses",         PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"LLC-stores",              PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	       {"LLC-store-misses",        PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"dTLB-loads",              PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	       {"dTLB-misses",             PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"dTLB-load-misses",        PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"dTLB-store-misses",       PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"iTLB-load-misses",        PERF_TYPE_HW_CACHE, NVSL_CACHE_EVENT(PERF_COUNT_HW_CACHE_ITLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	       {"task-clock",              PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+	       {"page-faults",             PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+	       {"minor-faults",            PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN},
+	       {"major-faults",            PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ},
+	       {"context-switches",        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+	       {"cpu-migrations",          PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+	  };
+#undef NVSL_CACHE_EVENT
+	  for(unsigned int i = 0; i < sizeof(events)/sizeof(events[0]); i++) {
+	       if (name == events[i].name) {
+		    type = events[i].type;
+		    config = events[i].config;
+		    return true;
+	       }
+	  }
+	  return false;
+     }
+
+     // A group of perf counters on the calling thread (any CPU it runs
+     // on), started and stopped together so the counts cover exactly the
+     // same instructions.  User-space only, so it works with the default
+     // perf_event_paranoid.  If the kernel has to multiplex the counters,
+     // Read() scales the counts up by how long they actually ran.
+     class PerfCounterGroup {
+	  std::vector<int> _fds;
+
+     public:
+	  ~PerfCounterGroup() {
+	       Close();
+	  }
+
+	  bool IsOpen() const {return !_fds.empty();}
+
+	  // Open names (which must all be known to LookupPerfEvent()),
+	  // disabled.  Returns false and leaves nothing open on failure.
+	  bool Open(const std::vector<std::string> & names) {
+	       Close();
+	       for(unsigned int i = 0; i < names.size(); i++) {
+		    struct perf_event_attr attr;
+		    memset(&attr, 0, sizeof(attr));
+		    attr.size = sizeof(attr);
+		    uint32_t type;
+		    uint64_t config;
+		    if (!LookupPerfEvent(names[i], type, config)) {
+			 Close();
+			 return false;
+		    }
+		    attr.type = type;
+		    attr.config = config;
+		    attr.disabled = _fds.empty();
+		    attr.exclude_kernel = attr.type != PERF_TYPE_SOFTWARE;
+		    attr.exclude_hv = 1;
+		    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, _fds.empty() ? -1 : _fds[0], 0);
+		    if (fd < 0) {
+			 Close();
+			 return false;
+		    }
+		    _fds.push_back(fd);
+	       }
+	       return true;
+	  }
+
+	  void Close() {
+	       for(unsigned int i = 0; i < _fds.size(); i++) {
+		    close(_fds[i]);
+	       }
+	       _fds.clear();
+	  }
+
+	  inline void Start() {
+	       ioctl(_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	       ioctl(_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	  }
+
+	  inline void Stop() {
+	       ioctl(_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	  }
+
+	  // Add the counts (in Open() order) to totals.
+	  bool Read(std::vector<double> & totals) {
+	       std::vector<uint64_t> buf(3 + _fds.size());
+	       ssize_t want = buf.size() * sizeof(uint64_t);
+	       if (read(_fds[0], &buf[0], want) != want) {
+		    return false;
+	       }
+	       double enabled = buf[1];
+	       double running = buf[2];
+	       double scale = running > 0 ? enabled / running : 0;
+	       totals.resize(_fds.size());
+	       for(unsigned int i = 0; i < _fds.size(); i++) {
+		    totals[i] += buf[3 + i] * scale;
+	       }
+	       return true;
+	  }
+     };
+}
+#endif
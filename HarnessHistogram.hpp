@@ -0,0 +1,134 @@
+#ifndef HARNESS_HISTOGRAM_INCLUDED
+#define HARNESS_HISTOGRAM_INCLUDED
+
+#include <stdint.h>
+#include <cstring>
+
+namespace nvsl {
+     // A log-bucketed latency histogram in the style of HdrHistogram.  Values
+     // are grouped by their most significant bit and each power of two is
+     // split into SUB_BUCKETS linear sub-buckets, so any value is kept to
+     // within ~3% while the whole 64-bit range fits in a fixed table.
+     // Recording is a couple of shifts and an increment.  It is not thread
+     // safe: give each thread its own and Merge() them when the threads are
+     // done.
+     class LatencyHistogram {
+     public:
+	  static const unsigned int SUB_BUCKET_BITS = 5;
+	  static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	  static const unsigned int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+     private:
+	  uint64_t _counts[BUCKETS];
+	  uint64_t _total;
+	  uint64_t _min;
+	  uint64_t _max;
+	  uint64_t _sum;
+
+     public:
+	  LatencyHistogram() {
+	       Reset();
+	  }
+
+	  void Reset() {
+	       memset(_counts, 0, sizeof(_counts));
+	       _total = 0;
+	       _min = UINT64_MAX;
+	       _max = 0;
+	       _sum = 0;
+	  }
+
+	  inline static unsigned int BucketFor(uint64_t v) {
+	       if (v < SUB_BUCKETS) {
+		    return v;
+	       }
+	       unsigned int shift = (63 - __builtin_clzll(v)) - SUB_BUCKET_BITS;
+	       return (shift + 1) * SUB_BUCKETS + ((v >> shift) & (SUB_BUCKETS - 1));
+	  }
+
+	  // Smallest and largest values that land in bucket b.
+	  static uint64_t BucketLow(unsigned int b) {
+	       if (b < SUB_BUCKETS) {
+		    return b;
+	       }
+	       unsigned int shift = b / SUB_BUCKETS - 1;
+	       return static_cast<uint64_t>(SUB_BUCKETS + b % SUB_BUCKETS) << shift;
+	  }
+
+	  static uint64_t BucketHigh(unsigned int b) {
+	       if (b < SUB_BUCKETS) {
+		    return b;
+	       }
+	       unsigned int shift = b / SUB_BUCKETS - 1;
+	       return BucketLow(b) + ((1ull << shift) - 1);
+	  }
+
+	  inline void Record(uint64_t v) {
+	       _counts[BucketFor(v)]++;
+	       _total++;
+	       _sum += v;
+	       if (v < _min) _min = v;
+	       if (v > _max) _max = v;
+	  }
+
+	  void Merge(const LatencyHistogram & other) {
+	       if (other._total == 0) {
+		    return;
+	       }
+	       for(unsigned int i = 0; i < BUCKETS; i++) {
+		    _counts[i] += other._counts[i];
+	       }
+	       _total += other._total;
+	       _sum += other._sum;
+	       if (other._min < _min) _min = other._min;
+	       if (other._max > _max) _max = other._max;
+	  }
+
+	  // Take out what earlier held, where earlier is an older copy of
+	  // this histogram, leaving what was recorded since.  The new min
+	  // and max are only known to the bucket (and never past the old
+	  // max).
+	  void Subtract(const LatencyHistogram & earlier) {
+	       uint64_t max = _max;
+	       _total -= earlier._total;
+	       _sum -= earlier._sum;
+	       _min = UINT64_MAX;
+	       _max = 0;
+	       for(unsigned int i = 0; i < BUCKETS; i++) {
+		    _counts[i] -= earlier._counts[i];
+		    if (_counts[i] != 0) {
+			 if (_min == UINT64_MAX) _min = BucketLow(i);
+			 _max = BucketHigh(i) < max ? BucketHigh(i) : max;
+		    }
+	       }
+	  }
+
+	  uint64_t Count() const {return _total;}
+	  uint64_t Min() const {return _total ? _min : 0;}
+	  uint64_t Max() const {return _max;}
+	  double Mean() const {return _total ? static_cast<double>(_sum)/_total : 0;}
+
+	  // The value below which p percent of the recorded values fall.  Like
+	  // HdrHistogram, this reports the highest value equivalent to the
+	  // bucket the percentile lands in (but never more than the max).
+	  uint64_t Percentile(double p) const {
+	       if (_total == 0) {
+		    return 0;
+	       }
+	       uint64_t target = static_cast<uint64_t>(p / 100.0 * _total + 0.5);
+	       if (target < 1) target = 1;
+	       if (target > _total) target = _total;
+
+	       uint64_t seen = 0;
+	       for(unsigned int i = 0; i < BUCKETS; i++) {
+		    seen += _counts[i];
+		    if (seen >= target) {
+			 uint64_t v = BucketHigh(i);
+			 return v < _max ? v : _max;
+		    }
+	       }
+	       return _max;
+	  }
+     };
+}
+#endif
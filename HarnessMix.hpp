@@ -0,0 +1,93 @@
+#ifndef HARNESS_MIX_INCLUDED
+#define HARNESS_MIX_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+#include "FastRand.hpp"
+
+namespace nvsl {
+     // A weighted choice among a few ops, made with one table lookup and
+     // no branches.  The table has SLOTS entries, and each op gets a
+     // number of them in proportion to its weight (so weights are kept
+     // to within 1/SLOTS).  Pick() steps a random number generator and
+     // indexes the table with its top bits.
+     class OpMix {
+     public:
+	  static const unsigned int MAX_OPS = 16;
+	  static const unsigned int SLOT_BITS = 10;
+	  static const unsigned int SLOTS = 1 << SLOT_BITS;
+
+     private:
+	  uint8_t _table[SLOTS];
+	  unsigned int _slots[MAX_OPS];
+
+     public:
+	  OpMix() {
+	       std::vector<double> one(1, 1);
+	       Build(one);
+	  }
+
+	  // Hand out the slots by largest remainder, making sure every op
+	  // with a positive weight gets at least one.  Returns false if
+	  // there are too many ops, a negative weight or no weight at all.
+	  bool Build(const std::vector<double> & weights) {
+	       double sum = 0;
+	       for(unsigned int i = 0; i < weights.size(); i++) {
+		    if (weights[i] < 0) {
+			 return false;
+		    }
+		    sum += weights[i];
+	       }
+	       if (weights.empty() || weights.size() > MAX_OPS || sum <= 0) {
+		    return false;
+	       }
+	       unsigned int given = 0;
+	       std::vector<double> remainders(weights.size());
+	       for(unsigned int i = 0; i < weights.size(); i++) {
+		    double exact = weights[i] / sum * SLOTS;
+		    _slots[i] = static_cast<unsigned int>(exact);
+		    remainders[i] = exact - _slots[i];
+		    given += _slots[i];
+	       }
+	       for(; given < SLOTS; given++) {
+		    unsigned int most = 0;
+		    for(unsigned int i = 1; i < weights.size(); i++) {
+			 if (remainders[i] > remainders[most]) {
+			      most = i;
+			 }
+		    }
+		    _slots[most]++;
+		    remainders[most] = -1;
+	       }
+	       for(unsigned int i = 0; i < weights.size(); i++) {
+		    if (weights[i] > 0 && _slots[i] == 0) {
+			 unsigned int most = 0;
+			 for(unsigned int j = 1; j < weights.size(); j++) {
+			      if (_slots[j] > _slots[most]) {
+				   most = j;
+			      }
+			 }
+			 _slots[most]--;
+			 _slots[i]++;
+		    }
+	       }
+	       unsigned int slot = 0;
+	       for(unsigned int i = 0; i < weights.size(); i++) {
+		    for(unsigned int j = 0; j < _slots[i]; j++) {
+			 _table[slot++] = i;
+		    }
+	       }
+	       return true;
+	  }
+
+	  // The fraction of picks op will get.
+	  double Share(unsigned int op) const {return static_cast<double>(_slots[op]) / SLOTS;}
+
+	  // state is the caller's own RandXorShift64Star() state (seed it
+	  // with anything but 0).
+	  inline unsigned int Pick(uint64_t & state) const {
+	       return _table[RandXorShift64Star(&state) >> (64 - SLOT_BITS)];
+	  }
+     };
+}
+#endif
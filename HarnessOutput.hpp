@@ -0,0 +1,235 @@
+#ifndef HARNESS_OUTPUT_INCLUDED
+#define HARNESS_OUTPUT_INCLUDED
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <type_traits>
+
+namespace nvsl {
+     // One result as a list of named fields, in order, written as a
+     // tab or comma separated line (with a header line if asked for) or
+     // as one JSON object per line.  Numbers are written the way an
+     // ostream writes them, and strings are quoted or escaped as the
+     // format needs.
+     class ResultRecord {
+	  struct Field {
+	       std::string name;
+	       std::string value;
+	       bool isNumber;
+	  };
+	  std::vector<Field> _fields;
+
+	  static std::string CsvQuote(const std::string & s) {
+	       if (s.find_first_of(",\"\n") == std::string::npos) {
+		    return s;
+	       }
+	       std::string q = "\"";
+	       for(unsigned int i = 0; i < s.size(); i++) {
+		    if (s[i] == '"') {
+			 q += '"';
+		    }
+		    q += s[i];
+	       }
+	       return q + "\"";
+	  }
+
+	  static std::string TsvClean(const std::string & s) {
+	       std::string c(s);
+	       for(unsigned int i = 0; i < c.size(); i++) {
+		    if (c[i] == '\t' || c[i] == '\n') {
+			 c[i] = ' ';
+		    }
+	       }
+	       return c;
+	  }
+
+	  static std::string JsonString(const std::string & s) {
+	       std::string j = "\"";
+	       for(unsigned int i = 0; i < s.size(); i++) {
+		    unsigned char c = s[i];
+		    if (c == '"' || c == '\\') {
+			 j += '\\';
+			 j += c;
+		    } else if (c < 0x20) {
+			 char esc[8];
+			 snprintf(esc, sizeof(esc), "\\u%04x", c);
+			 j += esc;
+		    } else {
+			 j += c;
+		    }
+	       }
+	       return j + "\"";
+	  }
+
+	  static std::string JsonValue(const Field & f) {
+	       if (!f.isNumber) {
+		    return JsonString(f.value);
+	       }
+	       // JSON has no inf or nan.
+	       if (f.value.find_first_of("in") != std::string::npos) {
+		    return "null";
+	       }
+	       return f.value;
+	  }
+
+     public:
+	  template<class T>
+	  void Add(const std::string & name, const T & value) {
+	       std::ostringstream s;
+	       s << value;
+	       Field f = {name, s.str(), std::is_arithmetic<T>::value && !std::is_same<T, char>::value};
+	       _fields.push_back(f);
+	  }
+
+	  // Change the value of an existing field, in place (or add it).
+	  template<class T>
+	  void Set(const std::string & name, const T & value) {
+	       for(unsigned int i = 0; i < _fields.size(); i++) {
+		    if (_fields[i].name == name) {
+			 std::ostringstream s;
+			 s << value;
+			 _fields[i].value = s.str();
+			 _fields[i].isNumber = std::is_arithmetic<T>::value && !std::is_same<T, char>::value;
+			 return;
+		    }
+	       }
+	       Add(name, value);
+	  }
+
+	  // Add other's fields, with prefix in front of their names.
+	  void Append(const ResultRecord & other, const std::string & prefix) {
+	       for(unsigned int i = 0; i < other._fields.size(); i++) {
+		    Field f = other._fields[i];
+		    f.name = prefix + f.name;
+		    _fields.push_back(f);
+	       }
+	  }
+
+	  // The fields by name, e.g., to compare with a baseline.
+	  std::map<std::string, std::string> ToMap() const {
+	       std::map<std::string, std::string> row;
+	       for(unsigned int i = 0; i < _fields.size(); i++) {
+		    row[_fields[i].name] = _fields[i].value;
+	       }
+	       return row;
+	  }
+
+	  // format is "tsv", "csv" or "json".
+	  static bool IsFormat(const std::string & format) {
+	       return format == "tsv" || format == "csv" || format == "json";
+	  }
+
+	  void Write(std::ostream & out, const std::string & format, bool header) const {
+	       if (format == "json") {
+		    out << "{";
+		    for(unsigned int i = 0; i < _fields.size(); i++) {
+			 out << (i ? ", " : "") << JsonString(_fields[i].name) << ": " << JsonValue(_fields[i]);
+		    }
+		    out << "}\n";
+		    return;
+	       }
+	       bool csv = format == "csv";
+	       const char * sep = csv ? "," : "\t";
+	       if (header) {
+		    for(unsigned int i = 0; i < _fields.size(); i++) {
+			 out << (i ? sep : "") << (csv ? CsvQuote(_fields[i].name) : TsvClean(_fields[i].name));
+		    }
+		    out << "\n";
+	       }
+	       for(unsigned int i = 0; i < _fields.size(); i++) {
+		    out << (i ? sep : "") << (csv ? CsvQuote(_fields[i].value) : TsvClean(_fields[i].value));
+	       }
+	       out << "\n";
+	  }
+     };
+
+     // What machine and build a result came from.
+
+     static std::string CpuModel() {
+	  std::string model = "unknown";
+	  FILE * f = fopen("/proc/cpuinfo", "r");
+	  if (f == NULL) {
+	       return model;
+	  }
+	  char line[512];
+	  while (fgets(line, sizeof(line), f) != NULL) {
+	       if (!strncmp(line, "model name", 10)) {
+		    const char * colon = strchr(line, ':');
+		    if (colon != NULL) {
+			 model = colon + 1 + strspn(colon + 1, " \t");
+			 model.erase(model.find_last_not_of(" \n") + 1);
+		    }
+		    break;
+	       }
+	  }
+	  fclose(f);
+	  return model;
+     }
+
+     static std::string KernelVersion() {
+	  struct utsname u;
+	  if (uname(&u) != 0) {
+	       return "unknown";
+	  }
+	  return std::string(u.sysname) + " " + u.release;
+     }
+
+     static std::string HostName() {
+	  char name[256] = "";
+	  if (gethostname(name, sizeof(name)) != 0) {
+	       return "unknown";
+	  }
+	  name[sizeof(name) - 1] = 0;
+	  return name;
+     }
+
+     // The transparent hugepage setting is the bracketed word in
+     // "always [madvise] never".
+     static std::string ThpSetting() {
+	  char line[256] = "";
+	  FILE * f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	  if (f == NULL) {
+	       return "unknown";
+	  }
+	  if (fgets(line, sizeof(line), f) == NULL) {
+	       line[0] = 0;
+	  }
+	  fclose(f);
+	  const char * open = strchr(line, '[');
+	  const char * close = open ? strchr(open, ']') : NULL;
+	  if (close == NULL) {
+	       return "unknown";
+	  }
+	  return std::string(open + 1, close);
+     }
+
+     inline static std::string CompilerVersion() {
+#if defined(__clang__)
+	  return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+	  return std::string("gcc ") + __VERSION__;
+#else
+	  return "unknown";
+#endif
+     }
+
+     // The Makefile passes its flags in HARNESS_CFLAGS.  Otherwise all
+     // we can tell is whether the optimizer was on.
+     inline static std::string CompileFlags() {
+#if defined(HARNESS_CFLAGS)
+	  return HARNESS_CFLAGS;
+#elif defined(__OPTIMIZE__)
+	  return "unknown (optimized)";
+#else
+	  return "unknown (not optimized)";
+#endif
+     }
+}
+#endif
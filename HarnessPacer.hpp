@@ -0,0 +1,52 @@
+#ifndef HARNESS_PACER_INCLUDED
+#define HARNESS_PACER_INCLUDED
+
+#include <stdint.h>
+#include <math.h>
+#include "FastRand.hpp"
+
+namespace nvsl {
+     // The send schedule of one open-loop (-rate) thread.  Each call to
+     // Next() returns when the next op is supposed to start, whether or
+     // not the last one has finished.  Measuring latency from that time
+     // instead of from when the op actually started charges stalls to
+     // every op that had to wait behind them (no coordinated omission).
+     //
+     // Arrivals are evenly spaced, or Poisson (exponential gaps with the
+     // same mean).  Each thread has its own, on its own cache line.
+     class Pacer {
+	  double _next;
+	  double _intervalNs;
+	  bool _poisson;
+	  bool _started;
+	  uint64_t _seed;
+
+     public:
+	  Pacer() : _next(0), _intervalNs(0), _poisson(false), _started(false), _seed(1) {}
+
+	  void Start(uint64_t nowNs, double opsPerSec, bool poisson, uint64_t seed) {
+	       _next = nowNs;
+	       _intervalNs = 1e9 / opsPerSec;
+	       _poisson = poisson;
+	       _seed = seed ? seed : 1;
+	       _started = true;
+	  }
+
+	  void Stop() {_started = false;}
+	  bool IsStarted() const {return _started;}
+
+	  inline uint64_t Next() {
+	       uint64_t t = static_cast<uint64_t>(_next);
+	       if (_poisson) {
+		    // Uniform in (0, 1] from the top 53 bits.
+		    uint64_t r = RandXorShift64Star(&_seed);
+		    double u = ((r >> 11) + 1) * (1.0 / 9007199254740992.0);
+		    _next += -log(u) * _intervalNs;
+	       } else {
+		    _next += _intervalNs;
+	       }
+	       return t;
+	  }
+     } __attribute__((aligned(64)));
+}
+#endif
@@ -0,0 +1,104 @@
+#ifndef HARNESS_STATS_INCLUDED
+#define HARNESS_STATS_INCLUDED
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+namespace nvsl {
+     // Summary statistics over a handful of samples (e.g., the ops/sec of
+     // each trial).  Meant for tens of samples, not millions: it keeps
+     // them all.
+     class SampleStats {
+	  std::vector<double> _samples;
+
+	  // Linearly interpolated quantile of sorted samples.
+	  static double Quantile(const std::vector<double> & sorted, double q) {
+	       double pos = q * (sorted.size() - 1);
+	       unsigned int i = static_cast<unsigned int>(pos);
+	       if (i + 1 >= sorted.size()) {
+		    return sorted.back();
+	       }
+	       return sorted[i] + (pos - i) * (sorted[i + 1] - sorted[i]);
+	  }
+
+     public:
+	  // Two-sided 95% critical values of Student's t for 1..30 degrees
+	  // of freedom.  Past that, the normal 1.96 is close enough.
+	  static double T95(unsigned int dof) {
+	       static const double t[] = {
+		    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+	       if (dof == 0) {
+		    return 0;
+	       }
+	       return dof <= 30 ? t[dof - 1] : 1.96;
+	  }
+
+	  void Reset() {_samples.clear();}
+	  void Add(double v) {_samples.push_back(v);}
+	  unsigned int Count() const {return _samples.size();}
+	  double Sample(unsigned int i) const {return _samples[i];}
+
+	  // Drop samples outside Tukey's fences (more than 1.5 interquartile
+	  // ranges beyond the quartiles).  Needs at least 4 samples to mean
+	  // anything.  Returns how many were dropped.
+	  unsigned int RejectOutliers() {
+	       if (_samples.size() < 4) {
+		    return 0;
+	       }
+	       std::vector<double> sorted(_samples);
+	       std::sort(sorted.begin(), sorted.end());
+	       double q1 = Quantile(sorted, 0.25);
+	       double q3 = Quantile(sorted, 0.75);
+	       double low = q1 - 1.5 * (q3 - q1);
+	       double high = q3 + 1.5 * (q3 - q1);
+	       std::vector<double> kept;
+	       for(unsigned int i = 0; i < _samples.size(); i++) {
+		    if (_samples[i] >= low && _samples[i] <= high) {
+			 kept.push_back(_samples[i]);
+		    }
+	       }
+	       unsigned int dropped = _samples.size() - kept.size();
+	       _samples.swap(kept);
+	       return dropped;
+	  }
+
+	  double Mean() const {
+	       if (_samples.empty()) {
+		    return 0;
+	       }
+	       double sum = 0;
+	       for(unsigned int i = 0; i < _samples.size(); i++) {
+		    sum += _samples[i];
+	       }
+	       return sum / _samples.size();
+	  }
+
+	  // Sample (n - 1) standard deviation.
+	  double StdDev() const {
+	       if (_samples.size() < 2) {
+		    return 0;
+	       }
+	       double mean = Mean();
+	       double sum = 0;
+	       for(unsigned int i = 0; i < _samples.size(); i++) {
+		    sum += (_samples[i] - mean) * (_samples[i] - mean);
+	       }
+	       return sqrt(sum / (_samples.size() - 1));
+	  }
+
+	  double Min() const {return _samples.empty() ? 0 : *std::min_element(_samples.begin(), _samples.end());}
+	  double Max() const {return _samples.empty() ? 0 : *std::max_element(_samples.begin(), _samples.end());}
+
+	  // Half-width of the 95% confidence interval for the mean.
+	  double CI95() const {
+	       if (_samples.size() < 2) {
+		    return 0;
+	       }
+	       return T95(_samples.size() - 1) * StdDev() / sqrt(_samples.size());
+	  }
+     };
+}
+#endif
@@ -0,0 +1,63 @@
+#ifndef HARNESS_SWEEP_INCLUDED
+#define HARNESS_SWEEP_INCLUDED
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace nvsl {
+     // Parse a list of values to sweep over, like "1,2,4..64x2" or
+     // "1..1024x2".  Each comma separated item is either a number or a
+     // range:
+     //
+     //   a..b     a, a+1, ..., b
+     //   a..b+k   a, a+k, a+2k, ... up to b
+     //   a..bxk   a, a*k, a*k*k, ... up to b
+     //
+     // Every value is multiplied by unit (e.g., 1024*1024 for -footMB).
+     // Returns false if it doesn't parse.
+     static bool ParseSweepList(const std::string & list, unsigned long long unit, std::vector<unsigned long long> & out) {
+	  const char * p = list.c_str();
+	  while (*p) {
+	       char * end;
+	       unsigned long long first = strtoull(p, &end, 10);
+	       if (end == p) {
+		    return false;
+	       }
+	       p = end;
+	       unsigned long long last = first;
+	       unsigned long long step = 1;
+	       bool multiply = false;
+	       if (p[0] == '.' && p[1] == '.') {
+		    last = strtoull(p + 2, &end, 10);
+		    if (end == p + 2 || last < first) {
+			 return false;
+		    }
+		    p = end;
+		    if (*p == 'x' || *p == '+') {
+			 multiply = *p == 'x';
+			 step = strtoull(p + 1, &end, 10);
+			 if (end == p + 1 || step < 1 || (multiply && (step < 2 || first == 0))) {
+			      return false;
+			 }
+			 p = end;
+		    }
+	       }
+	       // Stop once the next value would pass last, checked before
+	       // stepping so ranges near ULLONG_MAX can't wrap around.
+	       for(unsigned long long v = first; ; v = multiply ? v * step : v + step) {
+		    out.push_back(v * unit);
+		    if (multiply ? v > last / step : last - v < step) {
+			 break;
+		    }
+	       }
+	       if (*p == ',') {
+		    p++;
+	       } else if (*p) {
+		    return false;
+	       }
+	  }
+	  return !out.empty();
+     }
+}
+#endif
@@ -0,0 +1,62 @@
+#ifndef HARNESS_TIMER_INCLUDED
+#define HARNESS_TIMER_INCLUDED
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace nvsl {
+     // Nanoseconds from CLOCK_MONOTONIC_RAW.  Unlike gettimeofday(), this
+     // never jumps or gets slewed by NTP, and it has ns resolution.
+     inline static uint64_t ReadMonotonicRawNs() {
+	  struct timespec now;
+	  clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	  return now.tv_sec * 1000000000ull + now.tv_nsec;
+     }
+
+     // Read the time stamp counter.  rdtscp waits for all earlier
+     // instructions to finish, so the op being timed can't leak past it.
+     // Elsewhere there's no TSC, and this is just ReadMonotonicRawNs().
+     inline static uint64_t ReadTSC() {
+#if defined(__x86_64__) || defined(__i386__)
+	  uint32_t lo, hi, aux;
+	  __asm__ __volatile__ ("rdtscp" : "=a" (lo), "=d" (hi), "=c" (aux) : : "memory");
+	  return (static_cast<uint64_t>(hi) << 32) | lo;
+#else
+	  return ReadMonotonicRawNs();
+#endif
+     }
+
+     // The TSC is only usable as a clock if it ticks at a constant rate
+     // regardless of frequency scaling and sleep states (CPUID
+     // 0x80000007:EDX[8]).  Always false off x86, so -tsc falls back
+     // to CLOCK_MONOTONIC_RAW.
+     inline static bool HasInvariantTSC() {
+#if defined(__x86_64__) || defined(__i386__)
+	  unsigned int eax, ebx, ecx, edx;
+	  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+	       return false;
+	  }
+	  return (edx & (1 << 8)) != 0;
+#else
+	  return false;
+#endif
+     }
+
+     // Measure how many TSC ticks there are per ns by spinning against
+     // CLOCK_MONOTONIC_RAW for ms milliseconds.
+     static double CalibrateTSC(unsigned int ms = 100) {
+	  uint64_t ns0 = ReadMonotonicRawNs();
+	  uint64_t tsc0 = ReadTSC();
+	  uint64_t ns1;
+	  uint64_t tsc1;
+	  do {
+	       tsc1 = ReadTSC();
+	       ns1 = ReadMonotonicRawNs();
+	  } while (ns1 - ns0 < ms * 1000000ull);
+	  return static_cast<double>(tsc1 - tsc0) / (ns1 - ns0);
+     }
+}
+#endif
@@ -9,13 +9,112 @@
 #include <pthread.h>
 #include <sys/time.h>
 #include <signal.h>
+#include <time.h>
+#include <errno.h>
 #include "AtomicOps.hpp"
 #include "HarnessBarrier.hpp"
 #include "FastRand.hpp"
+#include "RandDist.hpp"
+#include "HarnessHistogram.hpp"
+#include "HarnessTimer.hpp"
+#include "HarnessStats.hpp"
+#include "HarnessAffinity.hpp"
+#include "HarnessCounters.hpp"
+#include "HarnessOutput.hpp"
+#include "HarnessSweep.hpp"
+#include "HarnessPacer.hpp"
+#include "HarnessArena.hpp"
+#include "HarnessCold.hpp"
+#include "HarnessCompare.hpp"
+#include "HarnessMix.hpp"
 #include <assert.h>
 #include <list>
+#include <algorithm>
+#include <fstream>
+#include <utility>
+#include <type_traits>
 
 namespace nvsl {
+     // Calls op(id, seed) N times, unrolled at compile time.
+     template<unsigned int N>
+     struct UnrolledOps {
+	  template<class F>
+	  inline static void Run(F & op, int id, uint64_t & seed) {
+	       UnrolledOps<N - 1>::Run(op, id, seed);
+	       op(id, seed);
+	  }
+     };
+
+     template<>
+     struct UnrolledOps<0> {
+	  template<class F>
+	  inline static void Run(F &, int, uint64_t &) {}
+     };
+
+     // An op counter alone on its cache line, so threads bumping their own
+     // counters don't false share.
+     struct OpCounter {
+	  OpCounter() : ops(0) {}
+	  volatile long long ops;
+     } __attribute__((aligned(64)));
+
+     // A per-thread timestamp (ns), alone on its cache line for the same
+     // reason.
+     struct PaddedTimestamp {
+	  PaddedTimestamp() : ns(0) {}
+	  volatile uint64_t ns;
+     } __attribute__((aligned(64)));
+
+     // Which sweep point (plus 1, so 0 is never) a thread's slice of the
+     // footprint arena was last zeroed for.  Only GetFootprintBuffer()
+     // on that thread touches it, so it gets its own cache line too.
+     struct FootprintSlice {
+	  FootprintSlice() : zeroedForPoint(0) {}
+	  unsigned int zeroedForPoint;
+     } __attribute__((aligned(64)));
+
+     // What one thread did over all the trials of a run: ops (folded in
+     // from its OpCounter at the start of each trial) and how long it
+     // spent between the start barrier and finishing its ops.  Only
+     // that thread writes it, so it gets its own cache line too.
+     struct ThreadTotals {
+	  ThreadTotals() : ops(0), ns(0) {}
+	  unsigned long long ops;
+	  uint64_t ns;
+     } __attribute__((aligned(64)));
+
+     // What one thread has done in a RunMix(): how many of each op and
+     // their latencies, and which op it's running (so RecordLatency()
+     // knows where the latency goes).  random is its OpMix::Pick()
+     // state, seeded from its RandLFSR() seed by its first pick.
+     struct MixState {
+	  MixState() : current(0), random(0) {
+	       for(unsigned int i = 0; i < OpMix::MAX_OPS; i++) {
+		    ops[i] = 0;
+		    latency[i] = NULL;
+	       }
+	  }
+	  unsigned int current;
+	  uint64_t random;
+	  unsigned long long ops[OpMix::MAX_OPS];
+	  LatencyHistogram * latency[OpMix::MAX_OPS];
+     } __attribute__((aligned(64)));
+
+     // One BeginPhase()/EndPhase().  While the phase is open, ops,
+     // timedSeconds, firstTrial and latency are where the run stood
+     // when it began; EndPhase() turns ops and latency into what
+     // happened since.
+     struct PhaseResult {
+	  std::string name;
+	  double began;
+	  double seconds;
+	  unsigned long long ops;
+	  double timedSeconds;
+	  unsigned int firstTrial;
+	  LatencyHistogram latency;
+	  SampleStats trials;
+     };
+
      // Making it a template lets us define everything in this header.
      // Otherwise, we'd need a .cpp for the static members, and it would be
      // pain to include it everywhere.
@@ -31,24 +130,142 @@ namespace nvsl {
 	  static unsigned int _threadCount;
 	  static unsigned long long _operationCount;
 	  static volatile long long _operationsCompleted;
-	  static unsigned long long _operationsPerThread;
+	  // GetCompletedOperations() when the current trial started, so
+	  // -max counts each trial's ops, not the run's.
+	  static unsigned long long _trialBaseOps;
+	  static unsigned long long _opChunk;
+	  static OpCounter _operationsClaimed;
 	  static bool _reload;
 	  static bool _create;
 	  static bool _hang;
+	  static bool _recordLatency;
+	  static bool _useTSC;
+	  static double _nsPerTick;
+	  static uint64_t _tscBase;
+	  static bool _calibrate;
+	  static double _loopOverheadNs;
+	  static unsigned int _batchSize;
+	  static double _intervalMs;
+	  static std::string _intervalFile;
+	  static unsigned long long _bytesPerOp;
+	  static pthread_t _samplerThread;
+	  static volatile bool _samplerRunning;
+	  static double _warmup;
+	  static unsigned int _trials;
+	  static bool _rejectOutliers;
+	  static double _convergePct;
+	  static double _maxRunTime;
+	  static std::string _pinPolicy;
+	  static std::string _numaPolicy;
+	  static std::vector<int> _cpuOrder;
+	  static std::vector<int> _threadCpus;
+	  // The footprint arena (-pages, -footLayout).  It's mapped on
+	  // first use.  _footprintSlices and _sharedFootprintReady say
+	  // which sweep point each thread's slice (or, if shared, the
+	  // buffer) was last zeroed for.
+	  static std::string _pages;
+	  static bool _sharedFootprint;
+	  static char * _arena;
+	  static size_t _arenaBytes;
+	  static pthread_mutex_t _arenaLock;
+	  static std::vector<FootprintSlice*> _footprintSlices;
+	  static unsigned int _sharedFootprintReady;
+	  // -cold: what to do before each trial, and to what.
+	  static std::string _cold;
+	  static bool _coldFlush;
+	  static bool _coldEvict;
+	  static bool _coldDrop;
+	  static std::vector<std::pair<const void *, size_t> > _coldRegions;
+	  static std::vector<std::string> _coldFiles;
+	  static char * _evictBuffer;
+	  static size_t _evictBytes;
+	  static bool _warnedDrop;
+
+	  // -counters.  Each thread opens its own group and sums into its
+	  // own totals; PrintResults() adds them up.
+	  static std::vector<std::string> _counterNames;
+	  typedef std::vector<PerfCounterGroup*> CounterGroupVector;
+	  static CounterGroupVector _counterGroups;
+	  static std::vector<std::vector<double> > _counterTotals;
+	  // Open-loop load (-rate, -arrivals, -rateSweep).  _rate is the
+	  // current target across all threads, 0 for closed loop.
+	  static double _rate;
+	  static bool _poissonArrivals;
+	  static unsigned int _rateSweep;
+	  static double _peakOpsPerSec;
+	  static uint64_t _lightP99;
+	  static double _kneeOpsPerSec;
+	  static bool _pastKnee;
+	  typedef std::vector<Pacer*> PacerVector;
+	  static PacerVector _pacers;
+	  static std::string _format;
+	  static bool _headerPrinted;
+	  // -tc and -foot* lists.  Init() and NextSweepPoint() set
+	  // _threadCount and _footPrintB from them.
+	  static std::vector<unsigned long long> _threadCounts;
+	  static std::vector<unsigned long long> _footPrints;
+	  static unsigned int _sweepPoint;
+	  static unsigned int _requestedTrials;
+	  static std::string _outFile;
+	  // RunMix().  _mixNames outlives the run, for PrintResults().
+	  static OpMix _mix;
+	  static std::vector<std::string> _mixNames;
+	  static std::vector<MixState*> _mixStates;
+	  static bool _mixActive;
+	  // Phases of this sweep point, in the order they began, and the
+	  // open ones, innermost last.
+	  static std::vector<PhaseResult*> _phases;
+	  static std::vector<unsigned int> _openPhases;
+	  // -baseline: earlier results to compare each result with, and
+	  // how many regressed by more than -threshold percent.
+	  static std::vector<ResultRow> _baseline;
+	  static double _regressPct;
+	  static unsigned int _regressions;
+	  static ResultRecord _options;
+	  static double _timedSeconds;
+	  static double _mainRunTime;
+	  static unsigned long long _mainOperationCount;
+	  static SampleStats _trialStats;
 	  static std::string _file;
 	  static std::string _name;
 	  static std::string _system;
+	  // -seed: where every thread's random stream starts (see ThreadSeed()).
+	  static uint64_t _seed;
+	  // -dist: how benchmarks that pick indexes skew them.
+	  static std::string _distSpec;
+	  static AccessDistribution _distribution;
+	  // -modulo: pick random indexes with % (see RandBound).
+	  static bool _modulo;
 	  
-	  static Barrier *_startBarrier;
-	  static Barrier *_endBarrier;
-	  static Barrier *_runBarrier;
+	  static SpinBarrier *_trialBarrier;
+	  // -barrier: how long SpinBarrier waiters spin before sleeping.
+	  static std::string _barrierKind;
+	  static unsigned long _barrierSpins;
+	  // When each thread left the start barrier, and the biggest
+	  // spread between them seen so far.
+	  typedef std::vector<PaddedTimestamp*> TimestampVector;
+	  static TimestampVector _releaseNs;
+	  static uint64_t _startSkewNs;
 	  
 	  static std::string _usage;
 
+	  // Per-thread latency histograms.  Each thread only ever writes its
+	  // own; WaitForThreads() merges them into _latency.
+	  typedef std::vector<LatencyHistogram*> HistogramVector;
+	  static HistogramVector _histograms;
+	  static LatencyHistogram _latency;
+
+	  // Per-thread completed op counts.  Each thread only writes its own.
+	  typedef std::vector<OpCounter*> CounterVector;
+	  static CounterVector _threadOps;
+	  typedef std::vector<ThreadTotals*> ThreadTotalsVector;
+	  static ThreadTotalsVector _threadTotals;
+	  // -perthread: write a row per thread to a side file.
+	  static bool _perThread;
+	  static std::string _perThreadFile;
+
 	  static double GetNow() {
-	       struct timeval now;
-	       gettimeofday(&now, NULL);
-	       return  now.tv_sec + (now.tv_usec / 1000000.0);
+	       return GetTimestampNs() / 1000000000.0;
 	  }
 	  
      public:
@@ -72,25 +289,111 @@ namespace nvsl {
 	       int i=2;
 	       while(i < argc) {
 		    if (!std::strcmp(argv[i], "-tc"))
-			 _threadCount = atoi(argv[++i]);
+			 ParseSweepOption(argv, i, 1, _threadCounts);
 		    else if (!strcmp(argv[i], "-foot"))
-			 _footPrintB = atoll(argv[++i])*1024*1024;
+			 ParseSweepOption(argv, i, 1024*1024, _footPrints);
 		    else if (!strcmp(argv[i], "-footMB"))
-			 _footPrintB = atoll(argv[++i])*1024*1024;
+			 ParseSweepOption(argv, i, 1024*1024, _footPrints);
 		    else if (!strcmp(argv[i], "-footKB"))
-			 _footPrintB = atoll(argv[++i])*1024;
+			 ParseSweepOption(argv, i, 1024, _footPrints);
 		    else if (!strcmp(argv[i], "-footB"))
-			 _footPrintB = atoll(argv[++i]);
+			 ParseSweepOption(argv, i, 1, _footPrints);
 		    else if (!strcmp(argv[i], "-rt")) {
 			 durationSet = true;
-			 _runTimeSeconds = atoi(argv[++i]);
+			 _runTimeSeconds = atof(argv[++i]);
 		    } else if (!strcmp(argv[i], "-max")) {
 			 durationSet = true;
 			 _opCountSet = true;
-			 _operationCount = atoi(argv[++i]);
-			 
+			 _operationCount = strtoull(argv[++i], NULL, 10);
+		    } else if (!strcmp(argv[i], "-chunk")) {
+			 _opChunk = strtoull(argv[++i], NULL, 10);
 		    } else if (!strcmp(argv[i], "-file"))
 			 _file = argv[++i];
+		    else if (!strcmp(argv[i], "-lat"))
+			 _recordLatency = true;
+		    else if (!strcmp(argv[i], "-tsc"))
+			 _useTSC = true;
+		    else if (!strcmp(argv[i], "-calibrate"))
+			 _calibrate = true;
+		    else if (!strcmp(argv[i], "-interval"))
+			 _intervalMs = atof(argv[++i]);
+		    else if (!strcmp(argv[i], "-intervalFile"))
+			 _intervalFile = argv[++i];
+		    else if (!strcmp(argv[i], "-perthread"))
+			 _perThread = true;
+		    else if (!strcmp(argv[i], "-perthreadFile")) {
+			 _perThread = true;
+			 _perThreadFile = argv[++i];
+		    } else if (!strcmp(argv[i], "-warmup"))
+			 _warmup = atof(argv[++i]);
+		    else if (!strcmp(argv[i], "-trials"))
+			 _trials = atoi(argv[++i]);
+		    else if (!strcmp(argv[i], "-rejectOutliers"))
+			 _rejectOutliers = true;
+		    else if (!strcmp(argv[i], "-converge"))
+			 _convergePct = atof(argv[++i]);
+		    else if (!strcmp(argv[i], "-maxRunTime"))
+			 _maxRunTime = atof(argv[++i]);
+		    else if (!strcmp(argv[i], "-pin"))
+			 _pinPolicy = argv[++i];
+		    else if (!strcmp(argv[i], "-numa"))
+			 _numaPolicy = argv[++i];
+		    else if (!strcmp(argv[i], "-baseline")) {
+			 if (!ReadResults(argv[++i], _baseline)) {
+			      std::cerr << "Can't read -baseline file " << argv[i] << "\n";
+			      exit(-1);
+			 }
+		    } else if (!strcmp(argv[i], "-threshold"))
+			 _regressPct = atof(argv[++i]);
+		    else if (!strcmp(argv[i], "-pages"))
+			 _pages = argv[++i];
+		    else if (!strcmp(argv[i], "-cold"))
+			 _cold = argv[++i];
+		    else if (!strcmp(argv[i], "-footLayout")) {
+			 std::string layout = argv[++i];
+			 if (layout != "private" && layout != "shared") {
+			      std::cerr << "-footLayout must be private or shared\n";
+			      exit(-1);
+			 }
+			 _sharedFootprint = layout == "shared";
+		    }
+		    else if (!strcmp(argv[i], "-counters")) {
+			 std::string list = argv[++i];
+			 size_t start = 0;
+			 while (start <= list.size()) {
+			      size_t comma = std::min(list.find(',', start), list.size());
+			      _counterNames.push_back(list.substr(start, comma - start));
+			      start = comma + 1;
+			 }
+		    }
+		    else if (!strcmp(argv[i], "-rate"))
+			 _rate = atof(argv[++i]);
+		    else if (!strcmp(argv[i], "-arrivals")) {
+			 std::string arrivals = argv[++i];
+			 if (arrivals != "constant" && arrivals != "poisson") {
+			      std::cerr << "-arrivals must be constant or poisson\n";
+			      exit(-1);
+			 }
+			 _poissonArrivals = arrivals == "poisson";
+		    } else if (!strcmp(argv[i], "-rateSweep"))
+			 _rateSweep = atoi(argv[++i]);
+		    else if (!strcmp(argv[i], "-barrier"))
+			 _barrierKind = argv[++i];
+		    else if (!strcmp(argv[i], "-seed"))
+			 _seed = strtoull(argv[++i], NULL, 0);
+		    else if (!strcmp(argv[i], "-modulo"))
+			 _modulo = true;
+		    else if (!strcmp(argv[i], "-dist")) {
+			 _distSpec = argv[++i];
+			 if (!_distribution.Parse(_distSpec)) {
+			      std::cerr << "-dist must be uniform, zipf[:theta], latest[:theta], hotspot[:ops%,data%] or gauss[:sd%]\n";
+			      exit(-1);
+			 }
+		    }
+		    else if (!strcmp(argv[i], "-format"))
+			 _format = argv[++i];
+		    else if (!strcmp(argv[i], "-out"))
+			 _outFile = argv[++i];
 		    else if (!strcmp(argv[i], "-hang"))
 		         _hang = true;
 		    else if (!strcmp(argv[i], "-nondet"))
@@ -116,8 +419,158 @@ namespace nvsl {
 		    exit(-1);
 	       }
 
+	       _distribution.UseModulo(_modulo);
+
+
+	       if (_useTSC) {
+		    if (!HasInvariantTSC()) {
+			 std::cerr << "TSC is not invariant; using CLOCK_MONOTONIC_RAW instead of -tsc\n";
+			 _useTSC = false;
+		    } else {
+			 _nsPerTick = 1.0 / CalibrateTSC();
+			 _tscBase = ReadTSC();
+			 std::cerr << "TSC runs at " << 1.0 / _nsPerTick << " GHz\n";
+		    }
+	       }
+
+	       if (_pinPolicy.size()) {
+		    _cpuOrder = CpuOrder(_pinPolicy);
+		    if (_cpuOrder.empty()) {
+			 std::cerr << "-pin must be compact, scatter, smtlast or a CPU list like 0-3,8\n";
+			 exit(-1);
+		    }
+	       }
+
+	       // Set the policy here too, so memory the main thread
+	       // allocates follows it.
+	       if (_numaPolicy.size() && !SetMemoryPolicy(_numaPolicy)) {
+		    std::cerr << "-numa must be local, interleave or a node number, and the node must exist\n";
+		    exit(-1);
+	       }
+
+	       if (!IsPageKind(_pages)) {
+		    std::cerr << "-pages must be 4k, thp, 2m or 1g\n";
+		    exit(-1);
+	       }
+
+	       if (_cold.size()) {
+		    size_t start = 0;
+		    while (start <= _cold.size()) {
+			 size_t comma = std::min(_cold.find(',', start), _cold.size());
+			 std::string how = _cold.substr(start, comma - start);
+			 if (!IsColdStrategy(how)) {
+			      std::cerr << "-cold must be a list of clflush, evict and drop\n";
+			      exit(-1);
+			 }
+			 _coldFlush |= how == "clflush";
+			 _coldEvict |= how == "evict";
+			 _coldDrop |= how == "drop";
+			 start = comma + 1;
+		    }
+#if !defined(__x86_64__) && !defined(__i386__)
+		    if (_coldFlush) {
+			 std::cerr << "-cold clflush needs x86\n";
+			 exit(-1);
+		    }
+#endif
+		    if (_coldEvict) {
+			 // 4 KB pages, so reading it also fills the TLB
+			 // with its pages.  Written once, so each line has
+			 // a page of its own to come from.
+			 size_t llc = LastLevelCacheBytes();
+			 size_t bytes = llc ? 2 * llc : 64 << 20;
+			 _evictBuffer = reinterpret_cast<char *>(MapPages(bytes, "4k", _evictBytes));
+			 if (_evictBuffer == NULL) {
+			      std::cerr << "Can't map " << bytes << " B for -cold evict\n";
+			      exit(-1);
+			 }
+			 memset(_evictBuffer, 1, _evictBytes);
+		    }
+		    if (_file.size()) {
+			 _coldFiles.push_back(_file);
+		    }
+	       }
+
+	       if (_counterNames.size()) {
+		    for(unsigned int i = 0; i < _counterNames.size(); i++) {
+			 uint32_t type;
+			 uint64_t config;
+			 if (!LookupPerfEvent(_counterNames[i], type, config)) {
+			      std::cerr << "Unknown counter '" << _counterNames[i] << "' for -counters\n";
+			      exit(-1);
+			 }
+		    }
+		    // Make sure the kernel and CPU will give us these before
+		    // we count on it.
+		    PerfCounterGroup test;
+		    if (!test.Open(_counterNames)) {
+			 std::cerr << "Can't open -counters: " << strerror(errno) << ".  No PMU, or see /proc/sys/kernel/perf_event_paranoid.  Not counting.\n";
+			 _counterNames.clear();
+		    }
+	       }
+
+	       if (_rateSweep > 0) {
+		    // The first point of each sweep is closed loop, to
+		    // find the peak.
+		    _rate = 0;
+	       }
+	       if (_rate > 0 || _rateSweep > 0) {
+		    // Latency is the point of running open loop.
+		    _recordLatency = true;
+	       }
+
+	       if (!ResultRecord::IsFormat(_format)) {
+		    std::cerr << "-format must be tsv, csv or json\n";
+		    exit(-1);
+	       }
+
+	       if (_trials < 1) {
+		    std::cerr << "-trials must be at least 1\n";
+		    exit(-1);
+	       }
+	       _requestedTrials = _trials;
+
+	       if (_threadCounts.empty()) {
+		    _threadCounts.push_back(_threadCount);
+	       }
+	       if (_footPrints.empty()) {
+		    _footPrints.push_back(_footPrintB);
+	       }
+	       if (*std::min_element(_threadCounts.begin(), _threadCounts.end()) < 1) {
+		    std::cerr << "-tc must be at least 1\n";
+		    exit(-1);
+	       }
+	       _threadCount = _threadCounts[0];
+	       _footPrintB = _footPrints[0];
+
+	       // Spinning threads that have to share CPUs would just keep
+	       // the threads they're waiting for off them.
+	       if (_barrierKind.empty()) {
+		    _barrierKind = GetMaxThreadCount() > sysconf(_SC_NPROCESSORS_ONLN) ? "hybrid" : "spin";
+	       }
+	       if (_barrierKind == "spin") {
+		    _barrierSpins = ULONG_MAX;
+	       } else if (_barrierKind == "hybrid") {
+		    _barrierSpins = 1 << 14;
+	       } else if (_barrierKind == "block") {
+		    _barrierSpins = 0;
+	       } else {
+		    std::cerr << "-barrier must be spin, hybrid or block\n";
+		    exit(-1);
+	       }
 
-	       _operationsPerThread  = _operationCount/_threadCount;
+	       // Per-thread state for the most threads any point will use.
+	       for(unsigned int i = 0; i < GetMaxThreadCount(); i++) {
+		    _histograms.push_back(new LatencyHistogram);
+		    _threadOps.push_back(new OpCounter);
+		    _threadTotals.push_back(new ThreadTotals);
+		    _footprintSlices.push_back(new FootprintSlice);
+		    _pacers.push_back(new Pacer);
+		    _releaseNs.push_back(new PaddedTimestamp);
+		    _counterGroups.push_back(new PerfCounterGroup);
+		    _counterTotals.push_back(std::vector<double>(_counterNames.size()));
+	       }
+	       _trialBarrier = NewBarrier(_threadCount);
 	       _startTime = GetNow();
 
 	       argc = leftOvers.size();
@@ -133,12 +586,78 @@ namespace nvsl {
 	       sigaction(SIGINT, &act, NULL);
 
 	       StartTiming();
+
+	       if (_intervalMs > 0) {
+		    StartSampler();
+	       }
 	  }
 
 	  static const std::string & GetStandardOptionsUsage() {
 	       return _usage;
 	  }
 
+	  // Sweeps.  -tc and the -foot options take lists (see
+	  // ParseSweepList()), and the run is repeated for every
+	  // combination of footprint and thread count, thread counts
+	  // varying fastest (and, with -rateSweep, each of those at every
+	  // rate).  The first point's values are set when Init()
+	  // returns.  Run them all in one process with
+	  //
+	  //   do {
+	  //        ... start threads, WaitForThreads(), PrintResults() ...
+	  //   } while (NextSweepPoint());
+	  //
+	  // Set up anything that doesn't depend on the point (files,
+	  // mappings, buffers for GetMaxThreadCount() threads or
+	  // GetMaxFootPrintBytes()) once, before the loop.
+	  inline static unsigned int GetSweepPointCount() {return GetRateCount() * _threadCounts.size() * _footPrints.size();}
+	  inline static unsigned int GetSweepPoint() {return _sweepPoint;}
+	  inline static unsigned int GetMaxThreadCount() {return *std::max_element(_threadCounts.begin(), _threadCounts.end());}
+	  inline static size_t GetMaxFootPrintBytes() {return *std::max_element(_footPrints.begin(), _footPrints.end());}
+
+	  // Move on to the next point and get ready to run it (timing
+	  // starts again, as in Init()).  Returns false after the last one.
+	  static bool NextSweepPoint() {
+	       if (_rateSweep > 0) {
+		    FinishRatePoint();
+	       }
+	       if (_sweepPoint + 1 >= GetSweepPointCount()) {
+		    return false;
+	       }
+	       _sweepPoint++;
+	       unsigned int rates = GetRateCount();
+	       unsigned int rate = _sweepPoint % rates;
+	       _threadCount = _threadCounts[_sweepPoint / rates % _threadCounts.size()];
+	       _footPrintB = _footPrints[_sweepPoint / rates / _threadCounts.size()];
+	       if (_rateSweep > 0) {
+		    _rate = _peakOpsPerSec * rate / _rateSweep;
+	       }
+	       for(unsigned int i = 0; i < _pacers.size(); i++) {
+		    _pacers[i]->Stop();
+	       }
+
+	       ResetOperationCounts();
+	       _trials = _requestedTrials;
+	       _trialStats.Reset();
+	       _timedSeconds = 0;
+	       _stopTime = 0;
+	       for(unsigned int i = 0; i < _counterTotals.size(); i++) {
+		    std::fill(_counterTotals[i].begin(), _counterTotals[i].end(), 0);
+	       }
+	       _latency.Reset();
+	       ClearPhases();
+	       _threadCpus.clear();
+	       _startSkewNs = 0;
+	       delete _trialBarrier;
+	       _trialBarrier = NewBarrier(_threadCount);
+
+	       StartTiming();
+	       if (_intervalMs > 0) {
+		    StartSampler();
+	       }
+	       return true;
+	  }
+
 	  static void GracefulExit(int s) {std::cerr << "Received signal " << s << " exiting.\n"; exit(1);}
 
 	  static void SetRunTime(double t) {_runTimeSeconds = t;}
@@ -149,15 +668,404 @@ namespace nvsl {
 	  inline static size_t GetFootPrintKB()  {return _footPrintB/1024;}
 	  inline static size_t GetFootPrintBytes()  {return _footPrintB;}
 
+	  // The footprint, from one mmap() of GetMaxFootPrintBytes()
+	  // backed by -pages, so benchmarks don't time page faults or pay
+	  // for 4 KB pages they didn't ask for.  With -footLayout private
+	  // (the default), each thread gets its own cache-line aligned
+	  // slice of GetFootprintBufferBytes() = GetFootPrintBytes() /
+	  // GetThreadCount().  With shared, they all get the same
+	  // GetFootPrintBytes() buffer.
+	  //
+	  // The first call for a thread in each sweep point zeroes its
+	  // slice (the whole buffer if shared), which also faults it in.
+	  // Call it from the thread itself before the start barrier, so
+	  // that happens untimed and the pages land where -numa says.
+	  static void * GetFootprintBuffer(unsigned int threadId) {
+	       pthread_mutex_lock(&_arenaLock);
+	       if (_arena == NULL) {
+		    size_t bytes = std::max(GetMaxFootPrintBytes(), GetMaxThreadCount() * CacheLineBytes);
+		    _arena = reinterpret_cast<char *>(MapPages(bytes, _pages, _arenaBytes));
+		    if (_arena == NULL) {
+			 std::cerr << "Can't map " << bytes << " B of " << _pages << " pages for the footprint (are hugepages reserved?)\n";
+			 exit(-1);
+		    }
+	       }
+	       unsigned int point = _sweepPoint + 1;
+	       if (_sharedFootprint) {
+		    if (_sharedFootprintReady != point) {
+			 memset(_arena, 0, _footPrintB);
+			 _sharedFootprintReady = point;
+		    }
+		    pthread_mutex_unlock(&_arenaLock);
+		    return _arena;
+	       }
+	       pthread_mutex_unlock(&_arenaLock);
+	       char * slice = _arena + threadId * GetFootprintBufferBytes();
+	       if (_footprintSlices[threadId]->zeroedForPoint != point) {
+		    memset(slice, 0, GetFootprintBufferBytes());
+		    _footprintSlices[threadId]->zeroedForPoint = point;
+	       }
+	       return slice;
+	  }
+	  static size_t GetFootprintBufferBytes() {
+	       if (_sharedFootprint) {
+		    return _footPrintB;
+	       }
+	       return std::max(_footPrintB / _threadCount / CacheLineBytes * CacheLineBytes, CacheLineBytes);
+	  }
+	  inline static bool IsFootprintShared() {return _sharedFootprint;}
+	  // For benchmarks with their own shared option (e.g.,
+	  // time_GSPS -S).  Call it before GetFootprintBuffer().
+	  inline static void SetFootprintShared(bool shared) {_sharedFootprint = shared;}
+
+	  // Any other buffer (an I/O buffer, say), mapped the same way and
+	  // zeroed (so faulted in) by the caller.  Buffers smaller than one
+	  // of -pages' pages get 4 KB pages, so small per-thread buffers
+	  // don't each take a hugepage.  They last until the program exits.
+	  static void * AllocateBuffer(size_t bytes) {
+	       std::string pages = bytes >= PageKindBytes(_pages) ? _pages : "4k";
+	       size_t mapped;
+	       void * p = MapPages(bytes, pages, mapped);
+	       if (p == NULL) {
+		    std::cerr << "Can't map " << bytes << " B of " << pages << " pages (are hugepages reserved?)\n";
+		    exit(-1);
+	       }
+	       memset(p, 0, mapped);
+	       return p;
+	  }
+
 	  inline static unsigned int GetThreadCount()  {return _threadCount;}
 	  inline static unsigned long long GetOperationCount()  {return _operationCount;}
-	  inline static unsigned long long GetOperationCountPerThread()  {return _operationsPerThread;}
+	  inline static unsigned long long GetOperationCountPerThread()  {return _operationCount/_threadCount;}
+	  inline static unsigned long long GetOperationCountPerThread(unsigned int threadId)  {
+	       // Spreads the remainder over the first threads, so the
+	       // per-thread counts add up to exactly -max.
+	       return _operationCount/_threadCount + (threadId < _operationCount % _threadCount ? 1 : 0);
+	  }
 	  inline static void CompletedOperation() {nvsl::atomic_increment(&_operationsCompleted);}
-	  inline static unsigned long long GetCompletedOperations() {return _operationsCompleted;}
 	  inline static void CompletedOperations(long long numOps) {nvsl::atomic_exchange_and_add(&_operationsCompleted, numOps);}
+	  // Same, but counted in threadId's own padded counter, so there's no
+	  // shared write.  Only thread threadId may call it.
+	  inline static void CompletedOperations(unsigned int threadId, long long numOps) {_threadOps[threadId]->ops += numOps;}
+	  static unsigned long long GetCompletedOperations() {
+	       unsigned long long total = _operationsCompleted;
+	       for(unsigned int i = 0; i < _threadOps.size(); i++) {
+		    total += _threadOps[i]->ops;
+	       }
+	       return total;
+	  }
+
+	  // With -chunk, -max ops come from a shared pool instead of being
+	  // split evenly up front.  Threads take chunk ops at a time, so a
+	  // slow thread just takes fewer chunks instead of holding up the
+	  // end of the run.  Returns how many ops the caller got (less than
+	  // n near the end), or 0 once the pool is empty.
+	  inline static unsigned long long GetOperationChunk() {return _opChunk;}
+	  inline static unsigned long long ClaimOperations(unsigned long long n) {
+	       unsigned long long first = nvsl::atomic_exchange_and_add(&_operationsClaimed.ops, n);
+	       if (first >= _operationCount) {
+		    return 0;
+	       }
+	       return std::min(n, _operationCount - first);
+	  }
 	  inline static const std::string & GetFileName()  {return _file;}
+
+	  // The seed for thread threadId's RandLFSR() stream.  Each thread
+	  // gets its own stretch of the sequence (see RandStreamSeed()), and
+	  // the same -seed gives the same numbers every run.  RunOps() passes
+	  // these to the op; drivers with their own threads should use them
+	  // too.
+	  inline static uint64_t ThreadSeed(unsigned int threadId) {return RandStreamSeed(_seed, threadId);}
+	  inline static uint64_t GetSeed() {return _seed;}
+
+	  // The -dist distribution (uniform by default).  Benchmarks that
+	  // pick indexes Build() it for their range at each sweep point and
+	  // then Pick() from it with their thread's seed.
+	  inline static AccessDistribution & GetDistribution() {return _distribution;}
+	  // Whether -dist was given, for benchmarks whose default access
+	  // pattern isn't random at all.
+	  inline static bool IsDistributionSet() {return !_distSpec.empty();}
+
+	  // -modulo: GetDistribution() picks indexes with % instead of
+	  // RandBound and RandRange().
+	  inline static bool IsModulo() {return _modulo;}
+
+	  // How many bytes each op moves, for the bytesPerSec columns of
+	  // the results, -perthread and the -interval series.  0 (the
+	  // default) leaves them 0.
+	  inline static void SetBytesPerOp(unsigned long long bytes) {_bytesPerOp = bytes;}
+	  inline static unsigned long long GetBytesPerOp() {return _bytesPerOp;}
 	  inline static double GetElapsedRunTime() {return _stopTime - _startTime;}
 
+	  // Latency recording.  Pass -lat to turn it on.  Threads record
+	  // nanosecond latencies into their own histogram (no shared
+	  // writes), so threadId must be in [0, GetThreadCount()).  Custom
+	  // drivers can either call RecordLatency() directly or bracket an
+	  // op with LatencyStart()/LatencyEnd(), which cost nothing but a
+	  // branch when recording is off.
+	  inline static bool IsRecordingLatency() {return _recordLatency;}
+	  inline static uint64_t GetTimestampNs() {
+	       // With -tsc this is rdtscp scaled by the frequency measured in
+	       // Init(), otherwise CLOCK_MONOTONIC_RAW.
+	       if (_useTSC) {
+		    return static_cast<uint64_t>((ReadTSC() - _tscBase) * _nsPerTick);
+	       }
+	       return ReadMonotonicRawNs();
+	  }
+	  inline static void RecordLatency(unsigned int threadId, uint64_t ns) {
+	       _histograms[threadId]->Record(ns);
+	       if (_mixActive) {
+		    MixState * m = _mixStates[threadId];
+		    m->latency[m->current]->Record(ns);
+	       }
+	  }
+	  inline static uint64_t LatencyStart() {
+	       return _recordLatency ? GetTimestampNs() : 0;
+	  }
+	  inline static void LatencyEnd(unsigned int threadId, uint64_t start) {
+	       if (_recordLatency) {
+		    RecordLatency(threadId, GetTimestampNs() - start);
+	       }
+	  }
+	  inline static const LatencyHistogram & GetLatencyHistogram() {return _latency;}
+
+	  // Open-loop load.  With -rate, each of the threads issues ops at
+	  // GetRate() / GetThreadCount() ops/sec on a fixed schedule, and
+	  // latency is measured from when each op was supposed to start,
+	  // so an op that stalls is also charged to every op queued
+	  // behind it.  Drivers with their own loops get this by
+	  // bracketing each op with OpStart()/LatencyEnd() instead of
+	  // LatencyStart()/LatencyEnd().  Without -rate, OpStart() is just
+	  // LatencyStart().  BeginTrial() starts the schedule; otherwise
+	  // the first OpStart() does.
+	  inline static double GetRate() {return _rate;}
+	  static void StartPacing(unsigned int threadId) {
+	       _pacers[threadId]->Start(GetTimestampNs(), _rate / _threadCount, _poissonArrivals, (threadId + 1) * 0x9E3779B97F4A7C15ull);
+	  }
+	  inline static uint64_t OpStart(unsigned int threadId) {
+	       if (_rate <= 0) {
+		    return LatencyStart();
+	       }
+	       if (!_pacers[threadId]->IsStarted()) {
+		    StartPacing(threadId);
+	       }
+	       uint64_t intended = _pacers[threadId]->Next();
+	       WaitUntilNs(intended);
+	       return intended;
+	  }
+
+	  // Per-op cost of the harness itself (the RunOps() loop and
+	  // isDone()), as measured by -calibrate.  0 if not calibrated.
+	  inline static double GetLoopOverheadNs() {return _loopOverheadNs;}
+
+	  // Warmup and repeated trials.  With -warmup and -trials, RunOps()
+	  // runs an untimed warmup and then -trials timed trials on the
+	  // same threads, and PrintResults() summarizes the trials.  If you
+	  // run your own threads, do the same by wrapping the timed part of
+	  // each thread in
+	  //
+	  //   for(int t = FirstTrial(); t < GetTrialCount(); t++) {
+	  //        BeginTrial(threadId, t);
+	  //        ... run ops until isDone() or your share of -max ...
+	  //        EndTrial(threadId, t);
+	  //   }
+	  //
+	  // instead of joining your own barriers and calling StartTiming().
+	  // Trial -1 is the warmup.  It is as long as -warmup (seconds with
+	  // -rt, ops with -max), and its ops and latencies are thrown away.
+	  // With -converge, GetTrialCount() grows until the trials agree, so
+	  // check it every time around the loop.
+	  inline static int FirstTrial() {return _warmup > 0 ? -1 : 0;}
+	  inline static int GetTrialCount() {return _trials;}
+	  inline static const SampleStats & GetTrialStats() {return _trialStats;}
+
+	  static void BeginTrial(unsigned int threadId, int trial) {
+	       OpenCounters(threadId);
+	       if (trial >= 0) {
+		    MakeCold(threadId);
+	       }
+	       _trialBarrier->Join();
+	       if (threadId == 0) {
+		    StartTrial(trial);
+	       }
+	       _trialBarrier->Join();
+	       RecordRelease(threadId);
+	       if (_rate > 0) {
+		    StartPacing(threadId);
+	       }
+	       StartCounters(threadId);
+	  }
+
+	  static void EndTrial(unsigned int threadId, int trial) {
+	       StopCounters(threadId, trial >= 0);
+	       if (trial >= 0) {
+		    RecordFinish(threadId);
+	       }
+	       _trialBarrier->Join();
+	       if (trial < 0) {
+		    _histograms[threadId]->Reset();
+		    if (_mixActive) {
+			 ResetMixState(threadId);
+		    }
+	       }
+	       if (threadId == 0) {
+		    FinishTrial(trial);
+	       }
+	       // FinishTrial() may add a trial.  Wait so everyone sees it.
+	       _trialBarrier->Join();
+	  }
+
+	  // Cold starts.  With -cold, each timed trial starts with the
+	  // caches (and with evict, the TLBs) cold instead of holding
+	  // whatever setup or the last trial left in them.  clflush
+	  // flushes the footprint arena plus anything registered with
+	  // AddColdRegion() (e.g., a mapped file) out of every core.
+	  // evict has each thread read through a buffer twice the size of
+	  // the LLC, which evicts everything else from its core's caches
+	  // and TLB.  drop drops -file and anything registered with
+	  // AddColdFile() from the page cache, and, if we're allowed to,
+	  // every clean cached page, dentry and inode.
+	  //
+	  // BeginTrial() does this for you.  If you run your own threads
+	  // without it, have each of them call MakeCold(threadId) right
+	  // before the barrier that starts the timed part.  Thread 0 does
+	  // the flushing and dropping, so the others just evict.
+	  inline static bool IsCold() {return _cold.size() > 0;}
+	  static void AddColdRegion(const void * p, size_t bytes) {
+	       _coldRegions.push_back(std::make_pair(p, bytes));
+	  }
+	  static void AddColdFile(const std::string & file) {
+	       _coldFiles.push_back(file);
+	  }
+	  static void MakeCold(unsigned int threadId) {
+	       if (_coldEvict) {
+		    ReadThrough(_evictBuffer, _evictBytes);
+	       }
+	       if (threadId != 0) {
+		    return;
+	       }
+	       if (_coldFlush) {
+		    if (_arena != NULL) {
+			 FlushRange(_arena, _sharedFootprint ? _footPrintB : _threadCount * GetFootprintBufferBytes());
+		    }
+		    for(unsigned int i = 0; i < _coldRegions.size(); i++) {
+			 FlushRange(_coldRegions[i].first, _coldRegions[i].second);
+		    }
+	       }
+	       if (_coldDrop) {
+		    for(unsigned int i = 0; i < _coldFiles.size(); i++) {
+			 DropFileCache(_coldFiles[i]);
+		    }
+		    if (!DropAllCaches() && !_warnedDrop) {
+			 std::cerr << "-cold drop can't write /proc/sys/vm/drop_caches (not root?), so only the benchmark's files are dropped\n";
+			 _warnedDrop = true;
+		    }
+	       }
+	  }
+
+	  // Barriers for your own threads, of the kind -barrier asks for.
+	  // spin gets threads out of the barrier within about a cache
+	  // miss of each other, but needs a CPU per thread.  hybrid spins
+	  // for a while and then sleeps, and block always sleeps.  The
+	  // default is spin, or hybrid if there are more threads than
+	  // CPUs.
+	  static SpinBarrier * NewBarrier(unsigned int count) {
+	       return new SpinBarrier(count, _barrierSpins);
+	  }
+
+	  // Start skew.  Each thread calls RecordRelease() as it leaves
+	  // the barrier that starts the timed part (BeginTrial() does it
+	  // for you), and startSkewNs in the results is the most time
+	  // between the first and last thread getting going in any trial.
+	  inline static void RecordRelease(unsigned int threadId) {
+	       _releaseNs[threadId]->ns = GetTimestampNs();
+	  }
+	  inline static uint64_t GetStartSkewNs() {return _startSkewNs;}
+
+	  // Per-thread results.  Each thread calls RecordFinish() when it's
+	  // done with the timed ops (EndTrial() does it for you), and the
+	  // time since its RecordRelease() is how long it ran, for
+	  // -perthread and the fairness columns.  Threads that don't
+	  // call these are taken to have run for the whole run time.
+	  inline static void RecordFinish(unsigned int threadId) {
+	       uint64_t release = _releaseNs[threadId]->ns;
+	       if (release != 0) {
+		    _threadTotals[threadId]->ns += GetTimestampNs() - release;
+	       }
+	  }
+	  inline static unsigned long long GetThreadOperations(unsigned int threadId) {
+	       return _threadTotals[threadId]->ops + _threadOps[threadId]->ops;
+	  }
+	  static double GetThreadSeconds(unsigned int threadId) {
+	       uint64_t ns = _threadTotals[threadId]->ns;
+	       return ns > 0 ? ns / 1e9 : _stopTime - _startTime;
+	  }
+	  inline static double GetThreadOpsPerSec(unsigned int threadId) {
+	       return GetThreadOperations(threadId) / GetThreadSeconds(threadId);
+	  }
+
+	  // Hardware performance counters.  With -counters, BeginTrial() and
+	  // EndTrial() turn each thread's counters on right after the
+	  // threads are released and off before they wait at the end, so
+	  // they only see the timed ops.  If you run your own threads
+	  // without them, call StartCounters() right after your start
+	  // barrier and StopCounters() right after your loop.  Both do
+	  // nothing without -counters.
+	  inline static bool IsCounting() {return !_counterNames.empty();}
+
+	  static void OpenCounters(unsigned int threadId) {
+	       // perf counters belong to the thread that opens them, so this
+	       // has to happen on threadId's thread.  StartCounters() does
+	       // it if needed, but it takes a few system calls, so
+	       // BeginTrial() does it before the barrier instead.
+	       if (IsCounting() && !_counterGroups[threadId]->IsOpen()) {
+		    if (!_counterGroups[threadId]->Open(_counterNames)) {
+			 std::cerr << "Thread " << threadId << " couldn't open its counters\n";
+		    }
+	       }
+	  }
+
+	  inline static void StartCounters(unsigned int threadId) {
+	       if (IsCounting()) {
+		    OpenCounters(threadId);
+		    if (_counterGroups[threadId]->IsOpen()) {
+			 _counterGroups[threadId]->Start();
+		    }
+	       }
+	  }
+
+	  // keep = false throws the counts away (e.g., for warmup).  This
+	  // closes the counters, since the thread may be about to exit.
+	  inline static void StopCounters(unsigned int threadId, bool keep = true) {
+	       if (IsCounting() && _counterGroups[threadId]->IsOpen()) {
+		    _counterGroups[threadId]->Stop();
+		    if (keep) {
+			 _counterGroups[threadId]->Read(_counterTotals[threadId]);
+		    }
+		    _counterGroups[threadId]->Close();
+	       }
+	  }
+
+	  // The trials of the innermost open phase, or all of them if no
+	  // phase is open.  Different phases are different workloads, so
+	  // their trials are never summarized together.
+	  static SampleStats CurrentTrials() {
+	       unsigned int first = _openPhases.empty() ? 0 : _phases[_openPhases.back()]->firstTrial;
+	       SampleStats trials;
+	       for(unsigned int i = first; i < _trialStats.Count(); i++) {
+		    trials.Add(_trialStats.Sample(i));
+	       }
+	       return trials;
+	  }
+
+	  // Half-width of the 95% confidence interval of ops/sec across the
+	  // current trials, as a percentage of the mean.
+	  static double GetPrecisionPct() {
+	       SampleStats trials = CurrentTrials();
+	       double mean = trials.Mean();
+	       return mean > 0 ? 100 * trials.CI95() / mean : 0;
+	  }
+
 
 	  static void PrintResults(std::ostream & out = std::cout) {  
 	       // Print out the timing and operation count results for the
@@ -165,17 +1073,592 @@ namespace nvsl {
 	       if (_stopTime == 0) {
 		    StopTiming();
 	       }
-	       out << "Bench\tConfig\tRunTime\tOperations\tThreads\topsPerSec\n";
-	       out <<     _system 
-		   << "\t" << _name 
-		   << "\t" << _stopTime - _startTime 
-		   << "\t" << _operationsCompleted 
-		   << "\t" << _threadCount 
-		   << "\t" << (static_cast<float>(_operationsCompleted)/(_stopTime - _startTime))
-		   << "\n";
+	       StopSampler();
+	       if (_trialStats.Count() == 0) {
+		    // A single trial run outside BeginTrial()/EndTrial().
+		    _trialStats.Add(GetCompletedOperations()/(_stopTime - _startTime));
+		    UpdateStartSkew();
+	       }
+	       // With phases, each phase rejects its own outliers (see
+	       // AddPhaseResults()).
+	       if (_rejectOutliers && _phases.empty()) {
+		    std::cerr << "Rejected " << _trialStats.RejectOutliers() << " outlier trials\n";
+	       }
+	       if (_perThread) {
+		    PrintPerThread();
+	       }
+	       // The whole run, then a row for each phase.
+	       while (!_openPhases.empty()) {
+		    EndPhase();
+	       }
+	       std::vector<ResultRecord> records(1 + _phases.size());
+	       AddResults(records[0]);
+	       for(unsigned int i = 0; i < _phases.size(); i++) {
+		    AddPhaseResults(records[i + 1], *_phases[i]);
+	       }
+	       ClearPhases();
+	       for(unsigned int i = 0; i < records.size() && _baseline.size(); i++) {
+		    CompareWithBaseline(records[i]);
+	       }
+	       if (_outFile.empty()) {
+		    // One header for a whole sweep.
+		    for(unsigned int i = 0; i < records.size(); i++) {
+			 records[i].Write(out, _format, !_headerPrinted);
+			 _headerPrinted = true;
+		    }
+		    return;
+	       }
+	       // Append, so a sweep can send every run to one file, and
+	       // only start the file with a header.
+	       std::ofstream file(_outFile.c_str(), std::ios::app);
+	       if (!file) {
+		    std::cerr << "Can't open -out file " << _outFile << "\n";
+		    for(unsigned int i = 0; i < records.size(); i++) {
+			 records[i].Write(out, _format, i == 0);
+		    }
+		    return;
+	       }
+	       file.seekp(0, std::ios::end);
+	       bool header = file.tellp() == 0;
+	       for(unsigned int i = 0; i < records.size(); i++) {
+		    records[i].Write(file, _format, header && i == 0);
+	       }
+	  }
+
+	  // What main() should return: 1 if any result regressed against
+	  // -baseline, 0 otherwise.
+	  inline static int GetExitStatus() {return _regressions > 0 ? 1 : 0;}
+
+	  // Benchmark-specific options, so they end up in every result
+	  // (as opt_<name>).  Call it for each of your options after
+	  // parsing them, defaults included.
+	  template<class V>
+	  static void RecordOption(const std::string & name, const V & value) {
+	       _options.Add(name, value);
+	  }
+
+	  // Everything PrintResults() prints: the results, then the
+	  // standard options, the benchmark's options and what machine
+	  // and build produced it.
+	  static void AddResults(ResultRecord & record) {
+	       double runTime = _stopTime - _startTime;
+	       record.Add("Bench", _system);
+	       record.Add("Config", _name);
+	       record.Add("Phase", "");
+	       record.Add("RunTime", runTime);
+	       record.Add("Operations", GetCompletedOperations());
+	       record.Add("Threads", _threadCount);
+	       record.Add("opsPerSec", static_cast<float>(GetCompletedOperations())/runTime);
+	       record.Add("nsPerOp", NsPerOp(GetCompletedOperations()/runTime));
+	       record.Add("bytesPerSec", GetCompletedOperations() * _bytesPerOp / runTime);
+	       record.Add("p50Ns", _latency.Percentile(50));
+	       record.Add("p90Ns", _latency.Percentile(90));
+	       record.Add("p99Ns", _latency.Percentile(99));
+	       record.Add("p999Ns", _latency.Percentile(99.9));
+	       record.Add("maxNs", _latency.Max());
+	       record.Add("loopNs", _loopOverheadNs);
+	       record.Add("adjOpsPerSec", AdjustedOpsPerSec(GetCompletedOperations()/runTime));
+	       record.Add("Batch", _batchSize);
+	       AddTrialResults(record);
+	       record.Add("CPUs", CpuListString());
+	       record.Add("startSkewNs", _startSkewNs);
+	       AddFairnessResults(record);
+	       AddCounterResults(record);
+	       AddMixResults(record);
+
+	       record.Add("mode", _opCountSet ? "max" : "rt");
+	       record.Add("rt", _runTimeSeconds);
+	       record.Add("max", _operationCount);
+	       record.Add("chunk", _opChunk);
+	       record.Add("footB", _footPrintB);
+	       record.Add("file", _file);
+	       record.Add("lat", _recordLatency);
+	       record.Add("tsc", _useTSC);
+	       record.Add("warmup", _warmup);
+	       record.Add("trials", _trials);
+	       record.Add("rejectOutliers", _rejectOutliers);
+	       record.Add("converge", _convergePct);
+	       record.Add("maxRunTime", _maxRunTime);
+	       record.Add("pin", _pinPolicy);
+	       record.Add("numa", _numaPolicy);
+	       record.Add("pages", _pages);
+	       record.Add("footLayout", _sharedFootprint ? "shared" : "private");
+	       record.Add("cache", IsCold() ? "cold" : "warm");
+	       record.Add("cold", _cold);
+	       std::string counters;
+	       for(unsigned int i = 0; i < _counterNames.size(); i++) {
+		    counters += (i ? "," : "") + _counterNames[i];
+	       }
+	       record.Add("counters", counters);
+	       record.Add("barrier", _barrierKind);
+	       record.Add("seed", _seed);
+	       record.Add("dist", _distSpec.empty() ? "uniform" : _distSpec);
+	       record.Add("modulo", _modulo);
+	       record.Add("rate", _rate);
+	       record.Add("arrivals", _poissonArrivals ? "poisson" : "constant");
+	       record.Add("rateSweep", _rateSweep);
+	       record.Append(_options, "opt_");
+
+	       record.Add("host", HostName());
+	       record.Add("cpuModel", CpuModel());
+	       record.Add("onlineCpus", sysconf(_SC_NPROCESSORS_ONLN));
+	       record.Add("kernel", KernelVersion());
+	       record.Add("thp", ThpSetting());
+	       record.Add("compiler", CompilerVersion());
+	       record.Add("compileFlags", CompileFlags());
 	  }
 
      private:
+	  static void ParseSweepOption(char ** argv, int & i, unsigned long long unit, std::vector<unsigned long long> & out) {
+	       // A later -foot* replaces an earlier one, as it always has.
+	       const char * option = argv[i++];
+	       out.clear();
+	       if (argv[i] == NULL || !ParseSweepList(argv[i], unit, out)) {
+		    std::cerr << option << " takes a number or a list like 1,2,4..64x2\n";
+		    exit(-1);
+	       }
+	  }
+
+	  static void EmptyOp(int, void *, uint64_t &) {}
+	  struct EmptyFunctor {
+	       inline void operator()(int, uint64_t &) {}
+	  };
+
+	  template<class Runner>
+	  static void Calibrate(Runner run) {
+	       // Run an empty FUT through the same RunOps() loop, and in the
+	       // same mode, as the real run to see what the harness costs per
+	       // op, then put everything back the way it was.  In -max mode,
+	       // run a fixed number of empty ops instead of the real count,
+	       // which could be tiny.  Only done once, by the first RunOps().
+	       _calibrate = false;
+	       double runTime = _runTimeSeconds;
+	       unsigned long long opCount = _operationCount;
+	       double warmup = _warmup;
+	       unsigned int trials = _trials;
+	       double convergePct = _convergePct;
+	       double rate = _rate;
+	       _warmup = 0;
+	       _rate = 0;
+	       _trials = 1;
+	       _convergePct = 0;
+	       if (_runTimeSeconds > 0) {
+		    _runTimeSeconds = std::min(_runTimeSeconds, 0.25);
+	       } else {
+		    _operationCount = (1ull << 24) * _threadCount;
+	       }
+
+	       run();
+	       if (_stopTime == 0) {
+		    StopTiming();
+	       }
+	       // Time per op, per thread.
+	       _loopOverheadNs = (_stopTime - _startTime) * 1e9 * _threadCount / GetCompletedOperations();
+	       std::cerr << "Harness overhead is " << _loopOverheadNs << " ns/op\n";
+
+	       _runTimeSeconds = runTime;
+	       _operationCount = opCount;
+	       _warmup = warmup;
+	       _trials = trials;
+	       _convergePct = convergePct;
+	       _rate = rate;
+	       ResetOperationCounts();
+	       _trialStats.Reset();
+	       _timedSeconds = 0;
+	       _stopTime = 0;
+	       _startSkewNs = 0;
+	       for(unsigned int i = 0; i < _counterTotals.size(); i++) {
+		    std::fill(_counterTotals[i].begin(), _counterTotals[i].end(), 0);
+	       }
+	       _latency.Reset();
+	  }
+
+	  // Per-op columns for the last RunMix(), named after the ops:
+	  // how many ran, their share of all ops, their throughput, and
+	  // (with -lat) their latency percentiles.
+	  static void AddMixResults(ResultRecord & record) {
+	       double runTime = _stopTime - _startTime;
+	       double total = GetCompletedOperations();
+	       for(unsigned int op = 0; op < _mixNames.size(); op++) {
+		    unsigned long long ops = 0;
+		    LatencyHistogram latency;
+		    for(unsigned int i = 0; i < _threadCount; i++) {
+			 ops += _mixStates[i]->ops[op];
+			 latency.Merge(*_mixStates[i]->latency[op]);
+		    }
+		    const std::string & name = _mixNames[op];
+		    record.Add(name + "Ops", ops);
+		    record.Add(name + "Pct", total > 0 ? 100 * ops / total : 0);
+		    record.Add(name + "OpsPerSec", ops / runTime);
+		    record.Add(name + "p50Ns", latency.Percentile(50));
+		    record.Add(name + "p99Ns", latency.Percentile(99));
+		    record.Add(name + "maxNs", latency.Max());
+	       }
+	  }
+
+	  // The trial statistics.  With phases, the trials are of different
+	  // workloads, so the whole run's row leaves them empty (which
+	  // also keeps -baseline from comparing it) and each phase's row
+	  // has its own.
+	  static void AddTrialResults(ResultRecord & record) {
+	       const char * names[] = {"Trials", "meanOpsPerSec", "sdOpsPerSec", "minOpsPerSec", "maxOpsPerSec", "ci95OpsPerSec", "precisionPct"};
+	       if (!_phases.empty()) {
+		    for(unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+			 record.Add(names[i], "");
+		    }
+		    return;
+	       }
+	       record.Add("Trials", _trialStats.Count());
+	       record.Add("meanOpsPerSec", _trialStats.Mean());
+	       record.Add("sdOpsPerSec", _trialStats.StdDev());
+	       record.Add("minOpsPerSec", _trialStats.Min());
+	       record.Add("maxOpsPerSec", _trialStats.Max());
+	       record.Add("ci95OpsPerSec", _trialStats.CI95());
+	       record.Add("precisionPct", GetPrecisionPct());
+	  }
+
+	  // A phase's row: the whole run's, with the throughput, latency
+	  // and trial columns replaced by the phase's own.
+	  static void AddPhaseResults(ResultRecord & record, PhaseResult & p) {
+	       AddResults(record);
+	       double opsPerSec = p.seconds > 0 ? p.ops / p.seconds : 0;
+	       if (p.trials.Count() == 0) {
+		    p.trials.Add(opsPerSec);
+	       }
+	       if (_rejectOutliers) {
+		    p.trials.RejectOutliers();
+	       }
+	       double mean = p.trials.Mean();
+	       record.Set("Phase", p.name);
+	       record.Set("RunTime", p.seconds);
+	       record.Set("Operations", p.ops);
+	       record.Set("opsPerSec", static_cast<float>(opsPerSec));
+	       record.Set("nsPerOp", NsPerOp(opsPerSec));
+	       record.Set("bytesPerSec", opsPerSec * _bytesPerOp);
+	       record.Set("p50Ns", p.latency.Percentile(50));
+	       record.Set("p90Ns", p.latency.Percentile(90));
+	       record.Set("p99Ns", p.latency.Percentile(99));
+	       record.Set("p999Ns", p.latency.Percentile(99.9));
+	       record.Set("maxNs", p.latency.Max());
+	       record.Set("adjOpsPerSec", AdjustedOpsPerSec(opsPerSec));
+	       record.Set("Trials", p.trials.Count());
+	       record.Set("meanOpsPerSec", mean);
+	       record.Set("sdOpsPerSec", p.trials.StdDev());
+	       record.Set("minOpsPerSec", p.trials.Min());
+	       record.Set("maxOpsPerSec", p.trials.Max());
+	       record.Set("ci95OpsPerSec", p.trials.CI95());
+	       record.Set("precisionPct", mean > 0 ? 100 * p.trials.CI95() / mean : 0);
+	  }
+
+	  static void ClearPhases() {
+	       for(unsigned int i = 0; i < _phases.size(); i++) {
+		    delete _phases[i];
+	       }
+	       _phases.clear();
+	       _openPhases.clear();
+	  }
+
+	  static void CompareWithBaseline(const ResultRecord & record) {
+	       // Match the result with the same configuration in the
+	       // baseline and say how it changed, on stderr so the results
+	       // stay clean.
+	       ResultRow row = record.ToMap();
+	       if (!IsComparable(row)) {
+		    return;
+	       }
+	       const ResultRow * before = FindBaseline(_baseline, row);
+	       if (before == NULL || !IsComparable(*before)) {
+		    std::cerr << "No baseline for " << ResultKey(row) << "\n";
+		    return;
+	       }
+	       Comparison c = CompareResults(*before, row, _regressPct);
+	       std::cerr << DescribeComparison(c) << "\n";
+	       if (c.verdict < 0) {
+		    _regressions++;
+	       }
+	  }
+
+	  // How evenly the threads shared the work, from each thread's own
+	  // ops/sec: Jain's index ((sum x)^2 / (n sum x^2), 1 when they're
+	  // all equal, 1/n when one thread did everything), the slowest
+	  // over the fastest, and the coefficient of variation.  All 0 if
+	  // the ops weren't counted per thread.
+	  static void AddFairnessResults(ResultRecord & record) {
+	       double sum = 0;
+	       double sumSquares = 0;
+	       double slowest = 0;
+	       double fastest = 0;
+	       for(unsigned int i = 0; i < _threadCount; i++) {
+		    double x = GetThreadOpsPerSec(i);
+		    sum += x;
+		    sumSquares += x * x;
+		    slowest = i ? std::min(slowest, x) : x;
+		    fastest = std::max(fastest, x);
+	       }
+	       double jain = 0;
+	       double cv = 0;
+	       if (sumSquares > 0) {
+		    double mean = sum / _threadCount;
+		    jain = sum * sum / (_threadCount * sumSquares);
+		    cv = sqrt(std::max(0.0, sumSquares / _threadCount - mean * mean)) / mean;
+	       }
+	       record.Add("jainIndex", jain);
+	       record.Add("minMaxRatio", fastest > 0 ? slowest / fastest : 0);
+	       record.Add("cvOpsPerSec", cv);
+	  }
+
+	  static void PrintPerThread() {
+	       // One row per thread, in -format, to the -perthread file.
+	       // Like -interval, the first sweep point starts the file.
+	       std::string name = _perThreadFile.size() ? _perThreadFile : _name + ".perthread";
+	       std::ofstream out(name.c_str(), _sweepPoint > 0 ? std::ios::app : std::ios::trunc);
+	       if (!out) {
+		    std::cerr << "Can't open " << name << " for -perthread output\n";
+		    return;
+	       }
+	       unsigned long long total = GetCompletedOperations();
+	       for(unsigned int i = 0; i < _threadCount; i++) {
+		    unsigned long long ops = GetThreadOperations(i);
+		    double seconds = GetThreadSeconds(i);
+		    ResultRecord record;
+		    record.Add("Bench", _system);
+		    record.Add("Config", _name);
+		    record.Add("Threads", _threadCount);
+		    record.Add("footB", _footPrintB);
+		    record.Add("rate", _rate);
+		    record.Add("Thread", i);
+		    record.Add("CPU", i < _threadCpus.size() ? _threadCpus[i] : -1);
+		    record.Add("Operations", ops);
+		    record.Add("Bytes", ops * _bytesPerOp);
+		    record.Add("Seconds", seconds);
+		    record.Add("opsPerSec", ops / seconds);
+		    record.Add("bytesPerSec", ops * _bytesPerOp / seconds);
+		    record.Add("sharePct", total > 0 ? 100.0 * ops / total : 0);
+		    record.Write(out, _format, _sweepPoint == 0 && i == 0);
+	       }
+	  }
+
+	  // One <counter>PerOp column per -counters event, plus IPC if we
+	  // have both cycles and instructions.
+	  static int CounterIndex(const std::string & name) {
+	       for(unsigned int i = 0; i < _counterNames.size(); i++) {
+		    if (_counterNames[i] == name) {
+			 return i;
+		    }
+	       }
+	       return -1;
+	  }
+
+	  static void AddCounterResults(ResultRecord & record) {
+	       std::vector<double> sums(_counterNames.size());
+	       for(unsigned int t = 0; t < _counterTotals.size(); t++) {
+		    for(unsigned int i = 0; i < sums.size() && i < _counterTotals[t].size(); i++) {
+			 sums[i] += _counterTotals[t][i];
+		    }
+	       }
+	       double ops = GetCompletedOperations();
+	       for(unsigned int i = 0; i < sums.size(); i++) {
+		    record.Add(_counterNames[i] + "PerOp", ops > 0 ? sums[i] / ops : 0);
+	       }
+	       int cycles = CounterIndex("cycles");
+	       int instructions = CounterIndex("instructions");
+	       if (cycles >= 0 && instructions >= 0) {
+		    record.Add("IPC", sums[cycles] > 0 ? sums[instructions] / sums[cycles] : 0);
+	       }
+	  }
+
+	  static std::string CpuListString() {
+	       // The CPU of each thread, in thread order, or "-" if we
+	       // didn't pin them.
+	       if (_cpuOrder.empty()) {
+		    return "-";
+	       }
+	       std::string list;
+	       for(unsigned int i = 0; i < _threadCpus.size(); i++) {
+		    char cpu[16];
+		    snprintf(cpu, sizeof(cpu), "%s%d", i ? "," : "", _threadCpus[i]);
+		    list += cpu;
+	       }
+	       return list;
+	  }
+
+	  static double NsPerOp(double opsPerSec) {
+	       // How long each op took a thread, on average.
+	       return opsPerSec > 0 ? 1e9 * _threadCount / opsPerSec : 0;
+	  }
+
+	  static double AdjustedOpsPerSec(double opsPerSec) {
+	       // Throughput with the calibrated harness overhead taken out
+	       // of each op.  0 if the ops are too fast to tell apart from
+	       // the harness.
+	       if (_loopOverheadNs == 0) {
+		    return opsPerSec;
+	       }
+	       double nsPerOp = 1e9 * _threadCount / opsPerSec - _loopOverheadNs;
+	       return nsPerOp > 0 ? 1e9 * _threadCount / nsPerOp : 0;
+	  }
+
+	  static void StartSampler() {
+	       _samplerRunning = true;
+	       pthread_create(&_samplerThread, NULL, Sampler, NULL);
+	  }
+
+	  static void StopSampler() {
+	       if (_samplerRunning) {
+		    _samplerRunning = false;
+		    pthread_join(_samplerThread, NULL);
+	       }
+	  }
+
+	  static void *Sampler(void *) {
+	       // Wake up every -interval ms and write how many ops (and
+	       // bytes) completed since the last sample.  It only reads the
+	       // per-thread counters, so it costs the benchmark threads
+	       // nothing beyond the occasional cache miss on their counter
+	       // lines.  Ticks are on an absolute schedule, so they don't
+	       // drift.  Time is seconds since Init().
+	       std::string file = _intervalFile.size() ? _intervalFile : _name + ".interval";
+	       // Later sweep points add on to the first point's file.
+	       std::ofstream out(file.c_str(), _sweepPoint > 0 ? std::ios::app : std::ios::trunc);
+	       if (!out) {
+		    std::cerr << "Can't open " << file << " for -interval output\n";
+		    return NULL;
+	       }
+	       if (_sweepPoint == 0) {
+		    out << "Bench\tConfig\tThreads\tfootB\tTime\tOperations\topsPerSec\tbytesPerSec\n";
+	       }
+
+	       uint64_t intervalNs = static_cast<uint64_t>(_intervalMs * 1000000);
+	       uint64_t base = ReadMonotonicRawNs();
+	       uint64_t last = base;
+	       unsigned long long lastOps = GetCompletedOperations();
+	       struct timespec wake;
+	       clock_gettime(CLOCK_MONOTONIC, &wake);
+	       while (_samplerRunning) {
+		    wake.tv_nsec += intervalNs % 1000000000;
+		    wake.tv_sec += intervalNs / 1000000000 + wake.tv_nsec / 1000000000;
+		    wake.tv_nsec %= 1000000000;
+		    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+
+		    uint64_t now = ReadMonotonicRawNs();
+		    unsigned long long ops = GetCompletedOperations();
+		    // Counts go back to 0 after -calibrate.
+		    unsigned long long delta = ops >= lastOps ? ops - lastOps : ops;
+		    double seconds = (now - last) / 1000000000.0;
+		    out <<     _system
+			<< "\t" << _name
+			<< "\t" << _threadCount
+			<< "\t" << _footPrintB
+			<< "\t" << (now - base) / 1000000000.0
+			<< "\t" << delta
+			<< "\t" << delta / seconds
+			<< "\t" << delta * _bytesPerOp / seconds
+			<< "\n";
+		    last = now;
+		    lastOps = ops;
+	       }
+	       return NULL;
+	  }
+
+	  // Only thread 0 calls these, between BeginTrial()'s and
+	  // EndTrial()'s barriers, so nobody else is running ops.
+	  static void StartTrial(int trial) {
+	       if (trial < 0) {
+		    // Swap in the warmup length.  FinishTrial() puts it back.
+		    _mainRunTime = _runTimeSeconds;
+		    _mainOperationCount = _operationCount;
+		    if (_operationCount > 0) {
+			 _operationCount = static_cast<unsigned long long>(_warmup);
+		    } else {
+			 _runTimeSeconds = _warmup;
+		    }
+	       }
+	       // Fold earlier trials' ops into the shared count (and each
+	       // thread's totals) and zero the per-thread counters and the
+	       // -chunk pool, so this trial starts fresh but the totals keep
+	       // adding up.
+	       _operationsCompleted = GetCompletedOperations();
+	       _operationsClaimed.ops = 0;
+	       for(unsigned int i = 0; i < _threadOps.size(); i++) {
+		    _threadTotals[i]->ops += _threadOps[i]->ops;
+		    _threadOps[i]->ops = 0;
+	       }
+	       _trialBaseOps = _operationsCompleted;
+	       _stopTime = 0;
+	       StartTiming();
+	  }
+
+	  static void FinishTrial(int trial) {
+	       if (_stopTime == 0) {
+		    StopTiming();
+	       }
+	       UpdateStartSkew();
+	       if (trial < 0) {
+		    _runTimeSeconds = _mainRunTime;
+		    _operationCount = _mainOperationCount;
+		    // Drop the warmup's ops.  StartTrial() already folded
+		    // the ones before it (e.g., an earlier RunOps() phase)
+		    // into the totals, so those stay.
+		    _operationsClaimed.ops = 0;
+		    for(unsigned int i = 0; i < _threadOps.size(); i++) {
+			 _threadOps[i]->ops = 0;
+		    }
+		    return;
+	       }
+	       double elapsed = _stopTime - _startTime;
+	       double opsPerSec = (GetCompletedOperations() - _trialBaseOps) / elapsed;
+	       _trialStats.Add(opsPerSec);
+	       _timedSeconds += elapsed;
+	       // So RunTime and opsPerSec in PrintResults() cover all the
+	       // trials together.
+	       _startTime = _stopTime - _timedSeconds;
+	       if (_trials > 1 || _convergePct > 0) {
+		    std::cerr << "Trial " << trial << ": " << opsPerSec << " ops/sec\n";
+	       }
+	       if (_convergePct > 0 && trial + 1 == static_cast<int>(_trials)) {
+		    // Out of trials.  Add another unless the confidence
+		    // interval is tight enough (it takes two to have one at
+		    // all) or we've hit -maxRunTime.
+		    bool converged = CurrentTrials().Count() >= 2 && GetPrecisionPct() <= _convergePct;
+		    if (converged) {
+			 std::cerr << "Converged to " << GetPrecisionPct() << "% after " << _trials << " trials\n";
+		    } else if (_timedSeconds + elapsed > _maxRunTime) {
+			 // Another trial as long as the last would go over.
+			 std::cerr << "Did not converge to " << _convergePct << "% in " << _maxRunTime << " s (got " << GetPrecisionPct() << "%)\n";
+		    } else {
+			 _trials++;
+		    }
+	       }
+	  }
+
+	  static void UpdateStartSkew() {
+	       // Fold the release times since the last call into the
+	       // skew and clear them for next time.
+	       uint64_t first = UINT64_MAX;
+	       uint64_t last = 0;
+	       for(unsigned int i = 0; i < _threadCount; i++) {
+		    uint64_t t = _releaseNs[i]->ns;
+		    if (t != 0) {
+			 first = std::min(first, t);
+			 last = std::max(last, t);
+		    }
+		    _releaseNs[i]->ns = 0;
+	       }
+	       if (last >= first) {
+		    _startSkewNs = std::max(_startSkewNs, last - first);
+	       }
+	  }
+
+	  static void ResetOperationCounts() {
+	       _operationsCompleted = 0;
+	       _trialBaseOps = 0;
+	       _operationsClaimed.ops = 0;
+	       for(unsigned int i = 0; i < _threadOps.size(); i++) {
+		    _threadOps[i]->ops = 0;
+		    *_threadTotals[i] = ThreadTotals();
+	       }
+	  }
+
 	  static void StopSignal(int i) { // don't call this.
 	       if (!_timingIsSuspended) {
 		    _stopTime = GetNow();
@@ -199,7 +1682,13 @@ namespace nvsl {
 	       act.sa_flags = SA_RESETHAND;
 	       sigaction(SIGALRM, &act, NULL);
 	       _timingIsSuspended = false;
-	       alarm(static_cast<unsigned int>(_runTimeSeconds));
+	       _finished = false;
+	       struct itimerval timer;
+	       bzero(&timer, sizeof(timer));
+	       timer.it_value.tv_sec = static_cast<time_t>(_runTimeSeconds);
+	       timer.it_value.tv_usec = static_cast<suseconds_t>((_runTimeSeconds - timer.it_value.tv_sec) * 1000000);
+	       setitimer(ITIMER_REAL, &timer, NULL); // all zeros disarms it
+
 	       volatile int temp = 1;
 	       if (_hang) {
 		    while(temp) {}
@@ -219,6 +1708,59 @@ namespace nvsl {
 	       _stopTime = GetNow();
 	       //std::cerr << "Timing stopped\n";
 	  }
+
+	  // Named phases.  Everything between BeginPhase(name) and
+	  // EndPhase() is reported again in a row of its own, with name in
+	  // the Phase column, so, e.g., setup and steady state can be
+	  // timed in one run:
+	  //
+	  //   BeginPhase("create");
+	  //   RunOps(create, NULL);
+	  //   EndPhase();
+	  //   BeginPhase("rename");
+	  //   RunOps(rename, NULL);
+	  //   EndPhase();
+	  //   PrintResults();
+	  //
+	  // Phases nest, and a nested phase is named after the ones it's
+	  // in ("setup/create").  A phase counts the ops completed and
+	  // latencies recorded while it was open, and the trials that
+	  // finished in it.  Its RunTime is the time those trials took,
+	  // or, if none did, the wall time it was open.  Call these from
+	  // one thread, while no ops are running (e.g., around RunOps() or
+	  // between WaitForThreads() and starting the next threads).
+	  static void BeginPhase(const std::string & name) {
+	       MergeLatency();
+	       PhaseResult * p = new PhaseResult;
+	       p->name = _openPhases.empty() ? name : _phases[_openPhases.back()]->name + "/" + name;
+	       p->began = GetNow();
+	       p->seconds = 0;
+	       p->ops = GetCompletedOperations();
+	       p->timedSeconds = _timedSeconds;
+	       p->firstTrial = _trialStats.Count();
+	       p->latency = _latency;
+	       _openPhases.push_back(_phases.size());
+	       _phases.push_back(p);
+	  }
+
+	  static void EndPhase() {
+	       if (_openPhases.empty()) {
+		    std::cerr << "EndPhase() without BeginPhase()\n";
+		    exit(-1);
+	       }
+	       MergeLatency();
+	       PhaseResult * p = _phases[_openPhases.back()];
+	       _openPhases.pop_back();
+	       p->ops = GetCompletedOperations() - p->ops;
+	       double timed = _timedSeconds - p->timedSeconds;
+	       p->seconds = timed > 0 ? timed : GetNow() - p->began;
+	       LatencyHistogram since(_latency);
+	       since.Subtract(p->latency);
+	       p->latency = since;
+	       for(unsigned int i = p->firstTrial; i < _trialStats.Count(); i++) {
+		    p->trials.Add(_trialStats.Sample(i));
+	       }
+	  }
 	  
 	  inline static bool isDone() {  // Check if the program should
 	       // terminate: either 1) it has
@@ -231,8 +1773,12 @@ namespace nvsl {
 	       }
 	       if (_operationCount == 0) {
 		    return  _finished;
+	       } else if (_opChunk > 0) {
+		    return static_cast<unsigned long long>(_operationsClaimed.ops) >= _operationCount;
 	       } else {
-		    return static_cast<unsigned int>(_operationsCompleted) >= _operationCount;
+		    // Just this trial's ops (StartTrial() folded the earlier
+		    // ones into the total).
+		    return GetCompletedOperations() - _trialBaseOps >= _operationCount;
 	       }
 	  }
 	       
@@ -241,9 +1787,49 @@ namespace nvsl {
 
 	  template<class C>
 	  static void StartThread(void *(*start_routine)(void*), C *arg) {
+	       // Threads are numbered in the order they're started (which
+	       // is thread id order for RunOps() and the examples), and -pin
+	       // and -numa place them by that number.
+	       unsigned int index = _threads.size();
+	       if (_threadCpus.size() <= index) {
+		    _threadCpus.resize(index + 1, -1);
+	       }
+	       if (!_cpuOrder.empty()) {
+		    _threadCpus[index] = _cpuOrder[index % _cpuOrder.size()];
+	       }
 	       pthread_t * t = new pthread_t;
 	       _threads.push_back(t);
-	       pthread_create(t, NULL, start_routine, reinterpret_cast<void*>(arg));
+	       pthread_create(t, NULL, PlacedThread, new ThreadStart(start_routine, reinterpret_cast<void*>(arg), _threadCpus[index]));
+	  }
+
+	  // The CPU StartThread() pinned thread index to, or -1 if it isn't
+	  // pinned.
+	  inline static int GetThreadCpu(unsigned int index) {
+	       return index < _threadCpus.size() ? _threadCpus[index] : -1;
+	  }
+
+	  struct ThreadStart {
+	       ThreadStart(void *(*r)(void*), void * a, int c) : routine(r), arg(a), cpu(c) {}
+	       void *(*routine)(void*);
+	       void * arg;
+	       int cpu;
+	  };
+
+	  static void *PlacedThread(void *a) {
+	       // Pin and set the memory policy from inside the new thread
+	       // (both are per thread), before it runs anything, so
+	       // whatever it touches first lands under its policy.
+	       ThreadStart * s = reinterpret_cast<ThreadStart *>(a);
+	       void *(*routine)(void*) = s->routine;
+	       void * arg = s->arg;
+	       if (s->cpu >= 0 && !PinToCpu(s->cpu)) {
+		    std::cerr << "Couldn't pin a thread to CPU " << s->cpu << "\n";
+	       }
+	       if (_numaPolicy.size()) {
+		    SetMemoryPolicy(_numaPolicy);
+	       }
+	       delete s;
+	       return routine(arg);
 	  }
 
 	  static void WaitForThreads() {
@@ -251,17 +1837,43 @@ namespace nvsl {
 		   i != _threads.end();
 		   i++) {
 		    pthread_join(**i, NULL);
+		    delete *i;
+	       }
+	       _threads.clear();
+	       MergeLatency();
+	  }
+
+	  static void MergeLatency() {
+	       // Fold the per-thread histograms into the result.  Only safe
+	       // once the threads that write them have stopped.
+	       for(unsigned int i = 0; i < _histograms.size(); i++) {
+		    _latency.Merge(*_histograms[i]);
+		    _histograms[i]->Reset();
 	       }
 	  }
 
 	  typedef void (OpFunction)(int, void *, uint64_t &);
 
+	  // One op of a RunMix(): its name (which prefixes its result
+	  // columns), its weight, and the op, as for RunOps().
+	  struct MixOp {
+	       MixOp(const std::string & n, double w, OpFunction * o, void * a = NULL) :
+		    name(n),
+		    weight(w),
+		    op(o),
+		    arg(a) {}
+	       std::string name;
+	       double weight;
+	       OpFunction * op;
+	       void * arg;
+	  };
+
 	  struct RunArgs {
 	       RunArgs(OpFunction run , void *arg, uint i):
 		    op_routine(run),
 		    arg(arg),
 		    id(i),
-		    randSeed(rand()){ 
+		    randSeed(ThreadSeed(i)){ 
 		    assert(randSeed != 0);
 	       } // Avoid zero
 	       OpFunction *op_routine;
@@ -271,61 +1883,393 @@ namespace nvsl {
 
 	  };
 
-	  typedef std::list<RunArgs * > ArgsList;
+	  // Adapts an OpFunction and its argument to the functor interface
+	  // RunLoop() expects.
+	  struct PointerOp {
+	       PointerOp(OpFunction * r, void * a) : op_routine(r), arg(a) {}
+	       OpFunction *op_routine;
+	       void * arg;
+	       inline void operator()(int id, uint64_t & seed) {
+		    op_routine(id, arg, seed);
+	       }
+	  };
 
-	  static ArgsList _argsList;
-	  
-	  static void *GenericThread(void *a) {
-	       RunArgs * args = reinterpret_cast< RunArgs * > (a);
-	       unsigned int threadOps = GetOperationCountPerThread();
-	       _startBarrier->Join();
-	  
-	       if (args->id == 0) {
-		    StartTiming();
+	  // The RunMix() op: pick one of the ops and run it, noting which
+	  // for its count and latency.
+	  struct MixRunner {
+	       MixRunner(const std::vector<MixOp> & o) : ops(&o) {}
+	       const std::vector<MixOp> * ops;
+	       inline void operator()(int id, uint64_t & seed) {
+		    MixState * m = _mixStates[id];
+		    if (m->random == 0) {
+			 m->random = RandLFSR(&seed) | 1;
+		    }
+		    unsigned int i = _mix.Pick(m->random);
+		    m->current = i;
+		    m->ops[i]++;
+		    (*ops)[i].op(id, (*ops)[i].arg, seed);
+	       }
+	  };
+
+	  static void ResetMixState(unsigned int threadId) {
+	       MixState * m = _mixStates[threadId];
+	       for(unsigned int op = 0; op < OpMix::MAX_OPS; op++) {
+		    m->ops[op] = 0;
+		    if (m->latency[op] != NULL) {
+			 m->latency[op]->Reset();
+		    }
+	       }
+	  }
+
+	  // The RunOps() worker pool.  Workers are started once, by the
+	  // first RunOps(), for the most threads any sweep point uses,
+	  // and park on _poolWake between calls.  Each RunOps() hands
+	  // them a job and waits on _poolIdle until the first
+	  // GetThreadCount() of them have run it; the rest stay parked.
+	  // That keeps thread creation out of multi-phase and sweep runs
+	  // and keeps each worker's stack, TLS and placement warm.
+	  typedef void (PoolJob)(unsigned int, void *);
+	  static std::vector<pthread_t> _pool;
+	  static std::vector<int> _poolCpus;
+	  static pthread_mutex_t _poolLock;
+	  static pthread_cond_t _poolWake;
+	  static pthread_cond_t _poolIdle;
+	  static PoolJob * _poolJob;
+	  static void * _poolContext;
+	  static unsigned long long _poolGeneration;
+	  static unsigned int _poolFinished;
+	  static bool _poolShutdown;
+
+	  static void *PoolWorker(void *a) {
+	       unsigned int id = reinterpret_cast<uintptr_t>(a);
+	       unsigned long long seen = 0;
+	       pthread_mutex_lock(&_poolLock);
+	       while (true) {
+		    while (_poolGeneration == seen && !_poolShutdown) {
+			 pthread_cond_wait(&_poolWake, &_poolLock);
+		    }
+		    if (_poolShutdown) {
+			 break;
+		    }
+		    seen = _poolGeneration;
+		    if (id < _threadCount) {
+			 PoolJob * job = _poolJob;
+			 void * context = _poolContext;
+			 pthread_mutex_unlock(&_poolLock);
+			 job(id, context);
+			 pthread_mutex_lock(&_poolLock);
+			 if (++_poolFinished == _threadCount) {
+			      pthread_cond_signal(&_poolIdle);
+			 }
+		    }
+	       }
+	       pthread_mutex_unlock(&_poolLock);
+	       return NULL;
+	  }
+
+	  static void RunOnPool(PoolJob * job, void * context) {
+	       if (_pool.empty()) {
+		    // Placed the same way StartThread() places threads.
+		    _pool.resize(GetMaxThreadCount());
+		    for(unsigned int i = 0; i < _pool.size(); i++) {
+			 int cpu = _cpuOrder.empty() ? -1 : _cpuOrder[i % _cpuOrder.size()];
+			 _poolCpus.push_back(cpu);
+			 pthread_create(&_pool[i], NULL, PlacedThread, new ThreadStart(PoolWorker, reinterpret_cast<void*>(static_cast<uintptr_t>(i)), cpu));
+		    }
+		    atexit(StopPool);
 	       }
-     
-	       _runBarrier->Join();    
-     
-	       if (threadOps == 0) {     
+	       pthread_mutex_lock(&_poolLock);
+	       _poolJob = job;
+	       _poolContext = context;
+	       _poolFinished = 0;
+	       _poolGeneration++;
+	       pthread_cond_broadcast(&_poolWake);
+	       while (_poolFinished < _threadCount) {
+		    pthread_cond_wait(&_poolIdle, &_poolLock);
+	       }
+	       pthread_mutex_unlock(&_poolLock);
+	       _threadCpus.assign(_poolCpus.begin(), _poolCpus.begin() + _threadCount);
+	       MergeLatency();
+	  }
+
+	  // Let the pool's workers exit.  Runs at exit; only call it
+	  // yourself if you need the threads gone sooner.  The next
+	  // RunOps() starts a new pool.
+	  static void StopPool() {
+	       if (_pool.empty()) {
+		    return;
+	       }
+	       pthread_mutex_lock(&_poolLock);
+	       _poolShutdown = true;
+	       pthread_cond_broadcast(&_poolWake);
+	       pthread_mutex_unlock(&_poolLock);
+	       for(unsigned int i = 0; i < _pool.size(); i++) {
+		    pthread_join(_pool[i], NULL);
+	       }
+	       _pool.clear();
+	       _poolCpus.clear();
+	       _poolShutdown = false;
+	  }
+
+	  template<unsigned int Batch, class F>
+	  static void RunLoop(unsigned int id, F & op, uint64_t & seed) {
+	       // The body of every harness thread: for the warmup and each
+	       // trial, wait for everyone, start the clock, then run op until
+	       // we're out of time or ops.  The -lat and untimed loops are
+	       // separate instantiations so the untimed ones don't pay for
+	       // the branch.
+	       for(int trial = FirstTrial(); trial < GetTrialCount(); trial++) {
+		    BeginTrial(id, trial);
+		    if (_recordLatency) {
+			 RunUntilDone<Batch, true>(id, op, seed);
+		    } else {
+			 RunUntilDone<Batch, false>(id, op, seed);
+		    }
+		    EndTrial(id, trial);
+	       }
+	  }
+
+	  template<unsigned int Batch, bool Timed, class F>
+	  static void RunUntilDone(unsigned int id, F & op, uint64_t & seed) {
+	       // Op counts go in this thread's own counter after each batch,
+	       // so nothing is shared but the -chunk pool.  isDone() is only
+	       // checked between batches.
+	       volatile long long & done = _threadOps[id]->ops;
+	       if (_rate > 0) {
+		    RunPaced(id, op, seed);
+	       } else if (_operationCount == 0) {
 		    while (!isDone()) {
-			 args->op_routine(args->id, args->arg, args->randSeed);
-			 threadOps++;
-		    }     
+			 RunBatch<Batch, Timed>(id, op, seed);
+			 done += Batch;
+		    }
+	       } else if (_opChunk > 0) {
+		    unsigned long long n;
+		    while ((n = ClaimOperations(_opChunk)) > 0) {
+			 RunCount<Batch, Timed>(id, op, seed, n);
+		    }
+	       } else {
+		    RunCount<Batch, Timed>(id, op, seed, GetOperationCountPerThread(id));
+	       }
+	  }
+
+	  template<class F>
+	  static void RunPaced(unsigned int id, F & op, uint64_t & seed) {
+	       // One op at a time, each at its scheduled time, so there's
+	       // no batching.  -chunk ops are claimed one at a time, which
+	       // is fine at rates slow enough to pace.
+	       volatile long long & done = _threadOps[id]->ops;
+	       unsigned long long mine = GetOperationCountPerThread(id);
+	       while (true) {
+		    if (_operationCount == 0 ? isDone() :
+			_opChunk > 0 ? ClaimOperations(1) == 0 :
+			static_cast<unsigned long long>(done) >= mine) {
+			 break;
+		    }
+		    uint64_t intended = OpStart(id);
+		    if (_operationCount == 0 && isDone()) {
+			 break;
+		    }
+		    UnrolledOps<1>::Run(op, id, seed);
+		    RecordLatency(id, GetTimestampNs() - intended);
+		    done += 1;
+	       }
+	  }
+
+	  static void WaitUntilNs(uint64_t when) {
+	       // Sleep until close, then spin, so low rates don't burn a
+	       // CPU per thread but wakeup latency doesn't get into the
+	       // schedule.  Gives up early if -rt runs out.
+	       while (!_finished) {
+		    uint64_t now = GetTimestampNs();
+		    if (now >= when) {
+			 return;
+		    }
+		    if (when - now > 100000) {
+			 uint64_t ns = when - now - 50000;
+			 struct timespec nap;
+			 nap.tv_sec = ns / 1000000000;
+			 nap.tv_nsec = ns % 1000000000;
+			 nanosleep(&nap, NULL);
+		    }
+	       }
+	  }
+
+	  static unsigned int GetRateCount() {return _rateSweep > 0 ? _rateSweep + 1 : 1;}
+
+	  static void FinishRatePoint() {
+	       // A -rateSweep runs closed loop first to find the peak, then
+	       // at 1/N, 2/N, ..., N/N of it.  The knee is the highest rate
+	       // that was still sustained (within 5%) with a p99 no more
+	       // than twice the p99 at the lightest load.
+	       unsigned int rate = _sweepPoint % GetRateCount();
+	       double achieved = GetCompletedOperations() / (_stopTime - _startTime);
+	       uint64_t p99 = _latency.Percentile(99);
+	       if (rate == 0) {
+		    _peakOpsPerSec = achieved;
+		    _kneeOpsPerSec = 0;
+		    _pastKnee = false;
+		    return;
+	       }
+	       if (rate == 1) {
+		    _lightP99 = p99;
+	       }
+	       if (!_pastKnee && achieved >= 0.95 * _rate && p99 <= 2 * _lightP99) {
+		    _kneeOpsPerSec = _rate;
 	       } else {
-		    for (unsigned int j = 0; j < threadOps; j++) {
-			 args->op_routine(args->id, args->arg, args->randSeed);
+		    _pastKnee = true;
+	       }
+	       if (rate == _rateSweep) {
+		    std::cerr << "Saturation knee at " << _kneeOpsPerSec << " ops/sec offered (closed-loop peak " << _peakOpsPerSec << " ops/sec, " << _threadCount << " threads, " << _footPrintB << " B)\n";
+	       }
+	  }
+
+	  template<unsigned int Batch, bool Timed, class F>
+	  static void RunCount(unsigned int id, F & op, uint64_t & seed, unsigned long long n) {
+	       volatile long long & done = _threadOps[id]->ops;
+	       for (unsigned long long j = 0; j < n / Batch; j++) {
+		    RunBatch<Batch, Timed>(id, op, seed);
+		    done += Batch;
+	       }
+	       for (unsigned long long j = 0; j < n % Batch; j++) {
+		    RunBatch<1, Timed>(id, op, seed);
+	       }
+	       done += n % Batch;
+	  }
+
+	  template<unsigned int Batch, bool Timed, class F>
+	  inline static void RunBatch(unsigned int id, F & op, uint64_t & seed) {
+	       // With -lat, each op in the batch is timed on its own, so
+	       // the percentiles are of single ops, not batch averages.
+	       // The batch still only sets how often isDone() is checked.
+	       if (Timed) {
+		    for (unsigned int i = 0; i < Batch; i++) {
+			 uint64_t start = GetTimestampNs();
+			 UnrolledOps<1>::Run(op, id, seed);
+			 RecordLatency(id, GetTimestampNs() - start);
 		    }
+	       } else {
+		    UnrolledOps<Batch>::Run(op, id, seed);
 	       }
-     
-	       CompletedOperations(threadOps);
-	       _runBarrier->Join();
-	       return  NULL;
+	  }
+
+	  static void GenericThread(unsigned int id, void * a) {
+	       RunArgs * args = (*reinterpret_cast<std::vector<RunArgs *> *>(a))[id];
+	       PointerOp op(args->op_routine, args->arg);
+	       RunLoop<1>(args->id, op, args->randSeed);
 	  }
 
 	  static void RunOps(OpFunction * op_routine, void *arg) {
-	       _startBarrier = new Barrier(_threadCount);
-	       _endBarrier   = new Barrier(_threadCount);
-	       _runBarrier   = new Barrier(_threadCount);
-	       
+	       _mixNames.clear();
+	       if (_calibrate) {
+		    Calibrate([] { RunOps(EmptyOp, NULL); });
+	       }
+	       _batchSize = 1;
+	       std::vector<RunArgs *> args;
 	       for(unsigned int i= 0; i< _threadCount; i++) {
 		    std::cerr << ".";
-		    RunArgs *n = new RunArgs(op_routine, arg, i);
-		    _argsList.push_back(n);
-		    StartThread(GenericThread,reinterpret_cast<void*>(n));
+		    args.push_back(new RunArgs(op_routine, arg, i));
 	       }
-	       
-	       WaitForThreads();
-	       
-	       for(typename ArgsList::iterator i = _argsList.begin(); 
-		   i != _argsList.end();
-		   i++) {
-		    delete *i;
+
+	       RunOnPool(GenericThread, &args);
+
+	       for(unsigned int i = 0; i < args.size(); i++) {
+		    delete args[i];
+	       }
+	  }
+
+	  // Each thread gets its own copy of the functor so stateful
+	  // functors don't share (or false share) their state.
+	  template<class Op>
+	  struct FunctorArgs {
+	       FunctorArgs(const Op & o, unsigned int i) :
+		    op(o),
+		    id(i),
+		    randSeed(ThreadSeed(i)) {
+		    assert(randSeed != 0);
+	       }
+	       Op op;
+	       const unsigned int id;
+	       uint64_t randSeed;
+	  };
+
+	  template<unsigned int Batch, class Op>
+	  static void FunctorThread(unsigned int id, void * a) {
+	       FunctorArgs<Op> * args = (*reinterpret_cast<std::vector<FunctorArgs<Op> *> *>(a))[id];
+	       RunLoop<Batch>(args->id, args->op, args->randSeed);
+	  }
+
+	  static const unsigned int DEFAULT_BATCH = 16;
+
+	  // Like RunOps(OpFunction*, void*), but op is any functor or lambda
+	  // callable as op(int threadId, uint64_t & seed).  Because the type
+	  // is known at compile time, op gets inlined into the loop, and the
+	  // loop calls it Batch times (unrolled) between isDone() checks.
+	  // Use Batch = 1 for ops that take long enough that overshooting
+	  // the run time by a batch matters.
+	  template<unsigned int Batch, class F>
+	  static void RunOps(F && op) {
+	       typedef typename std::decay<F>::type Op;
+	       _mixNames.clear();
+	       if (_calibrate) {
+		    Calibrate([] { RunOps<Batch>(EmptyFunctor()); });
+	       }
+	       _batchSize = Batch;
+	       std::vector<FunctorArgs<Op> *> args;
+	       for(unsigned int i= 0; i< _threadCount; i++) {
+		    std::cerr << ".";
+		    args.push_back(new FunctorArgs<Op>(op, i));
+	       }
+
+	       RunOnPool(FunctorThread<Batch, Op>, &args);
+
+	       for(unsigned int i = 0; i < args.size(); i++) {
+		    delete args[i];
 	       }
-	       _argsList.clear();
+	  }
+
+	  template<class F>
+	  static void RunOps(F && op) {
+	       RunOps<DEFAULT_BATCH>(std::forward<F>(op));
+	  }
 
-	       delete _startBarrier;
-	       delete _endBarrier;
-	       delete _runBarrier;
+	  // Like RunOps(), but for a mix of ops, e.g., 90% loads and 10%
+	  // persists.  Each time around the loop, a thread picks one of
+	  // ops with probability proportional to its weight, with a
+	  // precomputed table and a generator seeded from its RandLFSR()
+	  // seed (see OpMix), and runs it.  The results have the usual aggregate columns, then
+	  // <name>Ops, <name>Pct, <name>OpsPerSec and (with -lat)
+	  // <name>p50Ns, <name>p99Ns and <name>maxNs for each op.  Ops
+	  // run one per batch so each latency is charged to the right op.
+	  static void RunMix(const std::vector<MixOp> & ops) {
+	       std::vector<double> weights;
+	       for(unsigned int i = 0; i < ops.size(); i++) {
+		    weights.push_back(ops[i].weight);
+	       }
+	       if (!_mix.Build(weights)) {
+		    std::cerr << "RunMix() needs 1 to " << OpMix::MAX_OPS << " ops with non-negative weights that aren't all 0\n";
+		    exit(-1);
+	       }
+	       if (_calibrate) {
+		    Calibrate([] { RunOps<1>(EmptyFunctor()); });
+	       }
+	       while (_mixStates.size() < GetMaxThreadCount()) {
+		    _mixStates.push_back(new MixState);
+	       }
+	       for(unsigned int i = 0; i < _mixStates.size(); i++) {
+		    for(unsigned int op = 0; op < ops.size(); op++) {
+			 if (_mixStates[i]->latency[op] == NULL) {
+			      _mixStates[i]->latency[op] = new LatencyHistogram;
+			 }
+		    }
+		    ResetMixState(i);
+	       }
+	       _mixActive = true;
+	       RunOps<1>(MixRunner(ops));
+	       _mixActive = false;
+	       // After RunOps(), which forgets the last mix.
+	       for(unsigned int i = 0; i < ops.size(); i++) {
+		    _mixNames.push_back(ops[i].name);
+	       }
 	  }
      };
 
@@ -349,8 +2293,12 @@ namespace nvsl {
      unsigned long long _MicroBenchmarkHarness<C>::_operationCount = 0;
      template<class C> 
      volatile long long _MicroBenchmarkHarness<C>::_operationsCompleted = 0;
+     template<class C>
+     unsigned long long _MicroBenchmarkHarness<C>::_trialBaseOps = 0;
      template<class C> 
-     unsigned long long _MicroBenchmarkHarness<C>::_operationsPerThread= 0;
+     unsigned long long _MicroBenchmarkHarness<C>::_opChunk = 0;
+     template<class C> 
+     OpCounter _MicroBenchmarkHarness<C>::_operationsClaimed;
      template<class C>  
      bool _MicroBenchmarkHarness<C>::_reload = false;
      template<class C>  
@@ -359,6 +2307,100 @@ namespace nvsl {
      bool _MicroBenchmarkHarness<C>::_create = false;
      template<class C>
      bool _MicroBenchmarkHarness<C>::_hang = false;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_recordLatency = false;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_useTSC = false;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_nsPerTick = 0;
+     template<class C>
+     uint64_t _MicroBenchmarkHarness<C>::_tscBase = 0;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_calibrate = false;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_loopOverheadNs = 0;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_batchSize = 1;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_intervalMs = 0;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_intervalFile;
+     template<class C>
+     unsigned long long _MicroBenchmarkHarness<C>::_bytesPerOp = 0;
+     template<class C>
+     pthread_t _MicroBenchmarkHarness<C>::_samplerThread;
+     template<class C>
+     volatile bool _MicroBenchmarkHarness<C>::_samplerRunning = false;
+     template<class C>
+     typename _MicroBenchmarkHarness<C>::ThreadTotalsVector _MicroBenchmarkHarness<C>::_threadTotals;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_perThread = false;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_perThreadFile;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_warmup = 0;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_trials = 1;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_rejectOutliers = false;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_convergePct = 0;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_maxRunTime = 60;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_pinPolicy;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_numaPolicy;
+     template<class C>
+     std::vector<int> _MicroBenchmarkHarness<C>::_cpuOrder;
+     template<class C>
+     std::vector<int> _MicroBenchmarkHarness<C>::_threadCpus;
+     template<class C>
+     std::vector<std::string> _MicroBenchmarkHarness<C>::_counterNames;
+     template<class C>
+     typename _MicroBenchmarkHarness<C>::CounterGroupVector _MicroBenchmarkHarness<C>::_counterGroups;
+     template<class C>
+     std::vector<std::vector<double> > _MicroBenchmarkHarness<C>::_counterTotals;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_rate = 0;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_poissonArrivals = false;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_rateSweep = 0;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_peakOpsPerSec = 0;
+     template<class C>
+     uint64_t _MicroBenchmarkHarness<C>::_lightP99 = 0;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_kneeOpsPerSec = 0;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_pastKnee = false;
+     template<class C>
+     typename _MicroBenchmarkHarness<C>::PacerVector _MicroBenchmarkHarness<C>::_pacers;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_format = "tsv";
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_outFile;
+     template<class C>
+     ResultRecord _MicroBenchmarkHarness<C>::_options;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_headerPrinted = false;
+     template<class C>
+     std::vector<unsigned long long> _MicroBenchmarkHarness<C>::_threadCounts;
+     template<class C>
+     std::vector<unsigned long long> _MicroBenchmarkHarness<C>::_footPrints;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_sweepPoint = 0;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_requestedTrials = 1;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_timedSeconds = 0;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_mainRunTime = 0;
+     template<class C>
+     unsigned long long _MicroBenchmarkHarness<C>::_mainOperationCount = 0;
+     template<class C>
+     SampleStats _MicroBenchmarkHarness<C>::_trialStats;
      template<class C>  
      std::string _MicroBenchmarkHarness<C>::_file;
      template<class C>  
@@ -367,18 +2409,104 @@ namespace nvsl {
      std::string _MicroBenchmarkHarness<C>::_system;
 
      template<class C>  
-     Barrier * _MicroBenchmarkHarness<C>::_startBarrier;
-     template<class C>  
-     Barrier * _MicroBenchmarkHarness<C>::_endBarrier;
-     template<class C>  
-     Barrier * _MicroBenchmarkHarness<C>::_runBarrier;
+     SpinBarrier * _MicroBenchmarkHarness<C>::_trialBarrier;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_barrierKind;
+     template<class C>
+     uint64_t _MicroBenchmarkHarness<C>::_seed = 1;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_distSpec;
+     template<class C>
+     AccessDistribution _MicroBenchmarkHarness<C>::_distribution;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_modulo = false;
+     template<class C>
+     unsigned long _MicroBenchmarkHarness<C>::_barrierSpins = ULONG_MAX;
+     template<class C>
+     typename _MicroBenchmarkHarness<C>::TimestampVector _MicroBenchmarkHarness<C>::_releaseNs;
+     template<class C>
+     uint64_t _MicroBenchmarkHarness<C>::_startSkewNs = 0;
+     template<class C>
+     std::vector<pthread_t> _MicroBenchmarkHarness<C>::_pool;
+     template<class C>
+     std::vector<int> _MicroBenchmarkHarness<C>::_poolCpus;
+     template<class C>
+     pthread_mutex_t _MicroBenchmarkHarness<C>::_poolLock = PTHREAD_MUTEX_INITIALIZER;
+     template<class C>
+     OpMix _MicroBenchmarkHarness<C>::_mix;
+     template<class C>
+     std::vector<std::string> _MicroBenchmarkHarness<C>::_mixNames;
+     template<class C>
+     std::vector<MixState*> _MicroBenchmarkHarness<C>::_mixStates;
      template<class C>
-     typename _MicroBenchmarkHarness<C>::ArgsList _MicroBenchmarkHarness<C>::_argsList;
+     bool _MicroBenchmarkHarness<C>::_mixActive = false;
+     template<class C>
+     std::vector<PhaseResult*> _MicroBenchmarkHarness<C>::_phases;
+     template<class C>
+     std::vector<unsigned int> _MicroBenchmarkHarness<C>::_openPhases;
+     template<class C>
+     std::vector<ResultRow> _MicroBenchmarkHarness<C>::_baseline;
+     template<class C>
+     double _MicroBenchmarkHarness<C>::_regressPct = 5;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_regressions = 0;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_pages = "4k";
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_cold;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_coldFlush = false;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_coldEvict = false;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_coldDrop = false;
+     template<class C>
+     std::vector<std::pair<const void *, size_t> > _MicroBenchmarkHarness<C>::_coldRegions;
+     template<class C>
+     std::vector<std::string> _MicroBenchmarkHarness<C>::_coldFiles;
+     template<class C>
+     char * _MicroBenchmarkHarness<C>::_evictBuffer = NULL;
+     template<class C>
+     size_t _MicroBenchmarkHarness<C>::_evictBytes = 0;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_warnedDrop = false;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_sharedFootprint = false;
+     template<class C>
+     char * _MicroBenchmarkHarness<C>::_arena = NULL;
+     template<class C>
+     size_t _MicroBenchmarkHarness<C>::_arenaBytes = 0;
+     template<class C>
+     pthread_mutex_t _MicroBenchmarkHarness<C>::_arenaLock = PTHREAD_MUTEX_INITIALIZER;
+     template<class C>
+     std::vector<FootprintSlice*> _MicroBenchmarkHarness<C>::_footprintSlices;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_sharedFootprintReady = 0;
+     template<class C>
+     pthread_cond_t _MicroBenchmarkHarness<C>::_poolWake = PTHREAD_COND_INITIALIZER;
+     template<class C>
+     pthread_cond_t _MicroBenchmarkHarness<C>::_poolIdle = PTHREAD_COND_INITIALIZER;
+     template<class C>
+     typename _MicroBenchmarkHarness<C>::PoolJob * _MicroBenchmarkHarness<C>::_poolJob = NULL;
+     template<class C>
+     void * _MicroBenchmarkHarness<C>::_poolContext = NULL;
+     template<class C>
+     unsigned long long _MicroBenchmarkHarness<C>::_poolGeneration = 0;
+     template<class C>
+     unsigned int _MicroBenchmarkHarness<C>::_poolFinished = 0;
+     template<class C>
+     bool _MicroBenchmarkHarness<C>::_poolShutdown = false;
 
      template<class C>
      typename _MicroBenchmarkHarness<C>::ThreadVector _MicroBenchmarkHarness<C>::_threads;
      template<class C>
-     std::string _MicroBenchmarkHarness<C>::_usage = "<identifying string> [--help] [-rt <RunTime>|-max <MaxOps>] [-tc <#Threads>] [-footB <footprint B> | -footMB <footprint MB> |  -foot <FootprintMB> | -footKB <FootprintKB>]  [-file <backing file>] ";
+     typename _MicroBenchmarkHarness<C>::HistogramVector _MicroBenchmarkHarness<C>::_histograms;
+     template<class C>
+     typename _MicroBenchmarkHarness<C>::CounterVector _MicroBenchmarkHarness<C>::_threadOps;
+     template<class C>
+     LatencyHistogram _MicroBenchmarkHarness<C>::_latency;
+     template<class C>
+     std::string _MicroBenchmarkHarness<C>::_usage = "<identifying string> [--help] [-rt <RunTime>|-max <MaxOps> [-chunk <ChunkOps>]] [-tc <#Threads list>] [-footB <footprint B list> | -footMB <footprint MB list> |  -foot <FootprintMB list> | -footKB <FootprintKB list>]  [-file <backing file>] [-lat] [-tsc] [-calibrate] [-interval <ms> [-intervalFile <file>]] [-perthread [-perthreadFile <file>]] [-warmup <sec|ops>] [-trials <N> [-rejectOutliers]] [-converge <pct> [-maxRunTime <sec>]] [-pin compact|scatter|smtlast|<cpu list>] [-numa local|interleave|<node>] [-pages 4k|thp|2m|1g] [-footLayout private|shared] [-cold clflush,evict,drop] [-counters <event>,<event>,...] [-rate <ops/sec> | -rateSweep <N>] [-arrivals constant|poisson] [-barrier spin|hybrid|block] [-seed <N>] [-dist uniform|zipf[:theta]|latest[:theta]|hotspot[:ops,data]|gauss[:sd]] [-modulo] [-format tsv|csv|json] [-out <file>] [-baseline <file> [-threshold <pct>]] ";
 }
 #endif
 
@@ -0,0 +1,279 @@
+#ifndef NVSL_RAND_DIST_INCLUDED
+#define NVSL_RAND_DIST_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "FastRand.hpp"
+
+namespace nvsl {
+     // Which index in [0, n) to access next, for benchmarks whose real
+     // working sets are skewed.  -dist picks one:
+     //
+     //   uniform             every index equally likely (the default).
+     //   zipf[:theta]        Zipfian: the item of rank r gets weight
+     //                       1/(r+1)^theta (default 0.99, as in YCSB).
+     //                       The hot items are scattered over the range.
+     //   latest[:theta]      Zipfian by age: the end of the range is the
+     //                       newest and hottest, and it cools off toward
+     //                       the start.
+     //   hotspot[:ops,data]  ops% of the accesses go to the first data%
+     //                       of the range (default 80,20), and the rest
+     //                       to the rest, uniformly within each part.
+     //   gauss[:sd]          normal around the middle of the range, sd%
+     //                       of the range wide (default 10), cut off at
+     //                       its ends.
+     //
+     // Build(n) turns the distribution into a table of at most BUCKETS
+     // ranges of indexes, each with the share of the accesses that fall
+     // in it (exact for up to BUCKETS items; beyond that, zipf and
+     // latest buckets past the first BUCKETS / 2 ranks grow
+     // geometrically, and gauss buckets are equal width).  Pick() takes
+     // a range from an alias table (one multiply, one compare, no
+     // search) and an index in it uniformly, all without dividing.
+     class AccessDistribution {
+     public:
+	  static const unsigned int BUCKETS = 1024;
+
+	  enum Kind {
+	       Uniform,
+	       Zipf,
+	       Latest,
+	       Hotspot,
+	       Gauss
+	  };
+
+     private:
+	  Kind _kind;
+	  double _a;
+	  double _b;
+	  uint64_t _n;
+	  // Picks uniform indexes in [0, n).
+	  RandBound _bound;
+	  // -modulo: use % instead of RandBound and RandRange().
+	  bool _modulo;
+	  uint64_t _buckets;
+	  std::vector<uint32_t> _threshold;
+	  std::vector<uint32_t> _alias;
+	  std::vector<uint64_t> _start;
+	  std::vector<uint64_t> _width;
+
+	  // Sum of 1/(r+1)^theta for r in [begin, end).  Exact for short
+	  // runs, and the integral (which is very close) for long ones.
+	  static double ZipfMass(uint64_t begin, uint64_t end, double theta) {
+	       if (end - begin <= 64) {
+		    double sum = 0;
+		    for(uint64_t r = begin; r < end; r++) {
+			 sum += pow(r + 1.0, -theta);
+		    }
+		    return sum;
+	       }
+	       double lo = begin + 0.5;
+	       double hi = end + 0.5;
+	       if (fabs(theta - 1) < 1e-9) {
+		    return log(hi / lo);
+	       }
+	       return (pow(hi, 1 - theta) - pow(lo, 1 - theta)) / (1 - theta);
+	  }
+
+	  inline static double NormalCdf(double z) {return 0.5 * erfc(-z / sqrt(2.0));}
+
+	  // Vose's alias method over the buckets' masses.
+	  void BuildAlias(const std::vector<double> & mass) {
+	       _buckets = mass.size();
+	       double sum = 0;
+	       for(unsigned int i = 0; i < mass.size(); i++) {
+		    sum += mass[i];
+	       }
+	       std::vector<double> scaled(mass.size());
+	       std::vector<uint32_t> small;
+	       std::vector<uint32_t> large;
+	       for(unsigned int i = 0; i < mass.size(); i++) {
+		    scaled[i] = mass[i] / sum * mass.size();
+		    (scaled[i] < 1 ? small : large).push_back(i);
+	       }
+	       _threshold.assign(mass.size(), UINT32_MAX);
+	       _alias.resize(mass.size());
+	       for(unsigned int i = 0; i < mass.size(); i++) {
+		    _alias[i] = i;
+	       }
+	       while (!small.empty() && !large.empty()) {
+		    uint32_t s = small.back();
+		    uint32_t l = large.back();
+		    small.pop_back();
+		    _threshold[s] = static_cast<uint32_t>(scaled[s] * 4294967296.0);
+		    _alias[s] = l;
+		    scaled[l] -= 1 - scaled[s];
+		    if (scaled[l] < 1) {
+			 large.pop_back();
+			 small.push_back(l);
+		    }
+	       }
+	  }
+
+	  // Zipf buckets by rank: one rank each for the first BUCKETS / 2,
+	  // then geometrically wider up to n.
+	  void ZipfBuckets(std::vector<double> & mass) {
+	       uint64_t singles = std::min<uint64_t>(_n, _n <= BUCKETS ? BUCKETS : BUCKETS / 2);
+	       for(uint64_t r = 0; r < singles; r++) {
+		    _start.push_back(r);
+		    _width.push_back(1);
+	       }
+	       if (singles < _n) {
+		    double ratio = pow(static_cast<double>(_n) / singles, 1.0 / (BUCKETS - singles));
+		    uint64_t begin = singles;
+		    double edge = singles;
+		    while (begin < _n) {
+			 edge *= ratio;
+			 uint64_t end = std::min<uint64_t>(_n, std::max<uint64_t>(begin + 1, static_cast<uint64_t>(edge)));
+			 if (_start.size() == BUCKETS - 1) {
+			      end = _n;
+			 }
+			 _start.push_back(begin);
+			 _width.push_back(end - begin);
+			 begin = end;
+		    }
+	       }
+	       for(unsigned int i = 0; i < _start.size(); i++) {
+		    mass.push_back(ZipfMass(_start[i], _start[i] + _width[i], _a));
+	       }
+	  }
+
+	  // Lay the zipf buckets out over [0, n) in a shuffled order (the
+	  // same every time), so the hottest items aren't neighbors.  Items
+	  // in a bucket are equally hot, so they stay together.
+	  void Scatter() {
+	       std::vector<uint32_t> order(_start.size());
+	       for(unsigned int i = 0; i < order.size(); i++) {
+		    order[i] = i;
+	       }
+	       uint64_t state = 0x9e3779b97f4a7c15ull;
+	       for(unsigned int i = order.size() - 1; i > 0; i--) {
+		    std::swap(order[i], order[RandXorShift64Star(&state) % (i + 1)]);
+	       }
+	       uint64_t at = 0;
+	       for(unsigned int i = 0; i < order.size(); i++) {
+		    _start[order[i]] = at;
+		    at += _width[order[i]];
+	       }
+	  }
+
+     public:
+	  AccessDistribution() : _kind(Uniform), _a(0), _b(0), _n(0), _modulo(false), _buckets(0) {}
+
+	  // Parse a -dist spec (see above).  Returns false if it's not one.
+	  bool Parse(const std::string & spec) {
+	       size_t colon = spec.find(':');
+	       std::string name = spec.substr(0, colon);
+	       std::string args = colon == std::string::npos ? "" : spec.substr(colon + 1);
+	       size_t comma = args.find(',');
+	       bool hasA = !args.empty();
+	       bool hasB = comma != std::string::npos;
+	       double a = hasA ? atof(args.c_str()) : 0;
+	       double b = hasB ? atof(args.c_str() + comma + 1) : 0;
+	       if (name == "uniform" && !hasA) {
+		    _kind = Uniform;
+	       } else if ((name == "zipf" || name == "latest") && !hasB) {
+		    _kind = name == "zipf" ? Zipf : Latest;
+		    _a = hasA ? a : 0.99;
+		    if (_a <= 0) {
+			 return false;
+		    }
+	       } else if (name == "hotspot" && hasA == hasB) {
+		    _kind = Hotspot;
+		    _a = hasA ? a : 80;
+		    _b = hasB ? b : 20;
+		    if (_a < 0 || _a > 100 || _b <= 0 || _b > 100) {
+			 return false;
+		    }
+	       } else if (name == "gauss" && !hasB) {
+		    _kind = Gauss;
+		    _a = hasA ? a : 10;
+		    if (_a <= 0) {
+			 return false;
+		    }
+	       } else {
+		    return false;
+	       }
+	       return true;
+	  }
+
+	  // Pick indexes with % (slower, as the benchmarks used to) instead
+	  // of without dividing.  Takes effect at the next Build().
+	  void UseModulo(bool modulo) {_modulo = modulo;}
+
+	  inline Kind GetKind() const {return _kind;}
+	  inline uint64_t GetRange() const {return _n;}
+
+	  // Make the table for indexes [0, n).  Call it again whenever n
+	  // changes (e.g., at each sweep point), while nothing is picking.
+	  void Build(uint64_t n) {
+	       _n = n;
+	       _bound.Set(n, _modulo);
+	       _start.clear();
+	       _width.clear();
+	       std::vector<double> mass;
+	       if (_kind == Uniform || n == 0) {
+		    _buckets = 0;
+		    return;
+	       }
+	       if (_kind == Zipf || _kind == Latest) {
+		    ZipfBuckets(mass);
+		    if (_kind == Zipf) {
+			 Scatter();
+		    } else {
+			 // Rank 0 at the end.
+			 for(unsigned int i = 0; i < _start.size(); i++) {
+			      _start[i] = n - _start[i] - _width[i];
+			 }
+		    }
+	       } else if (_kind == Hotspot) {
+		    uint64_t hot = std::min<uint64_t>(n, std::max<uint64_t>(1, static_cast<uint64_t>(n * _b / 100)));
+		    _start.push_back(0);
+		    _width.push_back(hot);
+		    mass.push_back(hot == n ? 1 : _a);
+		    if (hot < n) {
+			 _start.push_back(hot);
+			 _width.push_back(n - hot);
+			 mass.push_back(100 - _a);
+		    }
+	       } else {
+		    double mean = n / 2.0;
+		    double sd = std::max(n * _a / 100, 0.5);
+		    uint64_t lo = static_cast<uint64_t>(std::max(0.0, mean - 6 * sd));
+		    uint64_t hi = static_cast<uint64_t>(std::min(static_cast<double>(n), ceil(mean + 6 * sd)));
+		    uint64_t count = std::min<uint64_t>(BUCKETS, hi - lo);
+		    for(uint64_t i = 0; i < count; i++) {
+			 uint64_t begin = lo + (hi - lo) * i / count;
+			 uint64_t end = lo + (hi - lo) * (i + 1) / count;
+			 _start.push_back(begin);
+			 _width.push_back(end - begin);
+			 mass.push_back(NormalCdf((end - mean) / sd) - NormalCdf((begin - mean) / sd));
+		    }
+	       }
+	       BuildAlias(mass);
+	  }
+
+	  // The next index.  seed is the caller's per-thread seed (e.g.,
+	  // from ThreadSeed()), and mustn't be 0.
+	  inline uint64_t Pick(uint64_t & seed) const {
+	       if (_buckets == 0) {
+		    return _bound(RandLFSR(&seed));
+	       }
+	       uint64_t x = RandXorShift64Star(&seed);
+	       uint32_t slot = ((x >> 32) * _buckets) >> 32;
+	       uint32_t bucket = static_cast<uint32_t>(x) < _threshold[slot] ? slot : _alias[slot];
+	       uint64_t i = _start[bucket];
+	       // No branch on the width: whether a zipf pick is a single
+	       // item or not is a coin toss the predictor can't learn, and
+	       // RandRange() of a width of 1 is 0 anyway.
+	       if (_modulo) {
+		    return _width[bucket] > 1 ? i + RandXorShift64Star(&seed) % _width[bucket] : i;
+	       }
+	       return i + RandRange(RandXorShift64Star(&seed), _width[bucket]);
+	  }
+     };
+}
+#endif
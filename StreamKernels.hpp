@@ -0,0 +1,264 @@
+#ifndef NVSL_STREAM_KERNELS_INCLUDED
+#define NVSL_STREAM_KERNELS_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Streaming kernels for bandwidth benchmarks.  Each one runs over bytes
+// bytes of up to three arrays:
+//
+//   load:     read a
+//   store:    write a
+//   copy:     a = b
+//   ntload:   read a with streaming loads (movntdqa), which on write-
+//             combining memory (e.g., some device mappings) don't go
+//             through the caches.  Same as load on ordinary memory
+//             on most CPUs.
+//   ntstore:  write a with non-temporal stores, which bypass the caches
+//   ntcopy:   a = b, with non-temporal stores
+//   scale:    a = q * b           (STREAM's scale, doubles, q = 3)
+//   add:      a = b + c           (STREAM's add)
+//   triad:    a = b + q * c       (STREAM's triad)
+//
+// in one of four flavors: scalar (plain C loops), sse2 (128-bit), avx2
+// (256-bit) and avx512 (512-bit).  The vector flavors are compiled with
+// target attributes, so they're all in every build and the CPU decides
+// at run time which can be used.  The arrays have to be 64-byte
+// aligned and bytes a multiple of 64.  Nothing here fences the
+// non-temporal stores; callers that care do it themselves.
+
+namespace nvsl {
+     typedef void (StreamFunction)(char * a, const char * b, const char * c, size_t bytes);
+
+     struct StreamKernel {
+	  const char * name;
+	  const char * isa;
+	  StreamFunction * run;
+	  // How many arrays it touches, so it moves arrays * bytes bytes
+	  // (STREAM's way of counting).
+	  unsigned int arrays;
+     };
+
+     namespace scalar {
+	  static void Load(char * a, const char *, const char *, size_t bytes) {
+	       const uint64_t * p = reinterpret_cast<const uint64_t *>(a);
+	       for(size_t i = 0; i < bytes / sizeof(uint64_t); i++) {
+		    uint64_t v = p[i];
+		    __asm__ __volatile__ ("" : : "r" (v));
+	       }
+	  }
+	  static void Store(char * a, const char *, const char *, size_t bytes) {
+	       uint64_t * p = reinterpret_cast<uint64_t *>(a);
+	       for(size_t i = 0; i < bytes / sizeof(uint64_t); i++) {
+		    p[i] = i;
+	       }
+	  }
+	  static void Copy(char * a, const char * b, const char *, size_t bytes) {
+	       uint64_t * d = reinterpret_cast<uint64_t *>(a);
+	       const uint64_t * s = reinterpret_cast<const uint64_t *>(b);
+	       for(size_t i = 0; i < bytes / sizeof(uint64_t); i++) {
+		    d[i] = s[i];
+	       }
+	  }
+#if defined(__x86_64__)
+	  // movnti is in every x86-64.  There's no scalar streaming load.
+	  static void NtStore(char * a, const char *, const char *, size_t bytes) {
+	       long long * p = reinterpret_cast<long long *>(a);
+	       for(size_t i = 0; i < bytes / sizeof(long long); i++) {
+		    _mm_stream_si64(p + i, i);
+	       }
+	  }
+	  static void NtCopy(char * a, const char * b, const char *, size_t bytes) {
+	       long long * d = reinterpret_cast<long long *>(a);
+	       const long long * s = reinterpret_cast<const long long *>(b);
+	       for(size_t i = 0; i < bytes / sizeof(long long); i++) {
+		    _mm_stream_si64(d + i, s[i]);
+	       }
+	  }
+#endif
+	  static void Scale(char * a, const char * b, const char *, size_t bytes) {
+	       double * d = reinterpret_cast<double *>(a);
+	       const double * s = reinterpret_cast<const double *>(b);
+	       for(size_t i = 0; i < bytes / sizeof(double); i++) {
+		    d[i] = 3.0 * s[i];
+	       }
+	  }
+	  static void Add(char * a, const char * b, const char * c, size_t bytes) {
+	       double * d = reinterpret_cast<double *>(a);
+	       const double * s = reinterpret_cast<const double *>(b);
+	       const double * t = reinterpret_cast<const double *>(c);
+	       for(size_t i = 0; i < bytes / sizeof(double); i++) {
+		    d[i] = s[i] + t[i];
+	       }
+	  }
+	  static void Triad(char * a, const char * b, const char * c, size_t bytes) {
+	       double * d = reinterpret_cast<double *>(a);
+	       const double * s = reinterpret_cast<const double *>(b);
+	       const double * t = reinterpret_cast<const double *>(c);
+	       for(size_t i = 0; i < bytes / sizeof(double); i++) {
+		    d[i] = s[i] + 3.0 * t[i];
+	       }
+	  }
+     }
+
+#if defined(__x86_64__)
+// The same kernels for one vector width.  VI and VD are its integer and
+// double vector types, and the rest are its intrinsics.  KEEP is the asm
+// constraint for a register of that width, so loaded values can be
+// "used" without doing anything with them.  The streaming load needs
+// SSE4.1 even in the sse2 flavor.
+#define NVSL_STREAM_KERNELS_DECL(ISA, TARGET, VI, VD, KEEP, LOADI, STOREI, NTLOADI, NTSTOREI, SETI, LOADD, STORED, SETD, ADDD, MULD) \
+     namespace ISA {							\
+	  __attribute__((target(TARGET)))				\
+	  static void Load(char * a, const char *, const char *, size_t bytes) { \
+	       for(size_t i = 0; i < bytes; i += sizeof(VI)) {		\
+		    VI v = LOADI(reinterpret_cast<const VI *>(a + i));	\
+		    __asm__ __volatile__ ("" : : KEEP (v));		\
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET ",sse4.1")))			\
+	  static void NtLoad(char * a, const char *, const char *, size_t bytes) { \
+	       for(size_t i = 0; i < bytes; i += sizeof(VI)) {		\
+		    VI v = NTLOADI(reinterpret_cast<VI *>(a + i));	\
+		    __asm__ __volatile__ ("" : : KEEP (v));		\
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET)))				\
+	  static void Store(char * a, const char *, const char *, size_t bytes) { \
+	       VI v = SETI(0x5a5a5a5a);					\
+	       for(size_t i = 0; i < bytes; i += sizeof(VI)) {		\
+		    STOREI(reinterpret_cast<VI *>(a + i), v);		\
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET)))				\
+	  static void NtStore(char * a, const char *, const char *, size_t bytes) { \
+	       VI v = SETI(0x5a5a5a5a);					\
+	       for(size_t i = 0; i < bytes; i += sizeof(VI)) {		\
+		    NTSTOREI(reinterpret_cast<VI *>(a + i), v);		\
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET)))				\
+	  static void Copy(char * a, const char * b, const char *, size_t bytes) { \
+	       for(size_t i = 0; i < bytes; i += sizeof(VI)) {		\
+		    STOREI(reinterpret_cast<VI *>(a + i), LOADI(reinterpret_cast<const VI *>(b + i))); \
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET)))				\
+	  static void NtCopy(char * a, const char * b, const char *, size_t bytes) { \
+	       for(size_t i = 0; i < bytes; i += sizeof(VI)) {		\
+		    NTSTOREI(reinterpret_cast<VI *>(a + i), LOADI(reinterpret_cast<const VI *>(b + i))); \
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET)))				\
+	  static void Scale(char * a, const char * b, const char *, size_t bytes) { \
+	       VD q = SETD(3.0);					\
+	       for(size_t i = 0; i < bytes; i += sizeof(VD)) {		\
+		    STORED(reinterpret_cast<double *>(a + i), MULD(q, LOADD(reinterpret_cast<const double *>(b + i)))); \
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET)))				\
+	  static void Add(char * a, const char * b, const char * c, size_t bytes) { \
+	       for(size_t i = 0; i < bytes; i += sizeof(VD)) {		\
+		    STORED(reinterpret_cast<double *>(a + i), ADDD(LOADD(reinterpret_cast<const double *>(b + i)), LOADD(reinterpret_cast<const double *>(c + i)))); \
+	       }							\
+	  }								\
+	  __attribute__((target(TARGET)))				\
+	  static void Triad(char * a, const char * b, const char * c, size_t bytes) { \
+	       VD q = SETD(3.0);					\
+	       for(size_t i = 0; i < bytes; i += sizeof(VD)) {		\
+		    STORED(reinterpret_cast<double *>(a + i), ADDD(LOADD(reinterpret_cast<const double *>(b + i)), MULD(q, LOADD(reinterpret_cast<const double *>(c + i))))); \
+	       }							\
+	  }								\
+     }
+
+NVSL_STREAM_KERNELS_DECL(sse2, "sse2", __m128i, __m128d, "x",
+			 _mm_load_si128, _mm_store_si128, _mm_stream_load_si128, _mm_stream_si128, _mm_set1_epi32,
+			 _mm_load_pd, _mm_store_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd);
+NVSL_STREAM_KERNELS_DECL(avx2, "avx2", __m256i, __m256d, "x",
+			 _mm256_load_si256, _mm256_store_si256, _mm256_stream_load_si256, _mm256_stream_si256, _mm256_set1_epi32,
+			 _mm256_load_pd, _mm256_store_pd, _mm256_set1_pd, _mm256_add_pd, _mm256_mul_pd);
+NVSL_STREAM_KERNELS_DECL(avx512, "avx512f", __m512i, __m512d, "v",
+			 _mm512_load_si512, _mm512_store_si512, _mm512_stream_load_si512, _mm512_stream_si512, _mm512_set1_epi32,
+			 _mm512_load_pd, _mm512_store_pd, _mm512_set1_pd, _mm512_add_pd, _mm512_mul_pd);
+#endif
+
+     // Every kernel in every flavor, scalar first and widest last.
+     static const StreamKernel StreamKernels[] = {
+	  {"load", "scalar", scalar::Load, 1},
+	  {"store", "scalar", scalar::Store, 1},
+	  {"copy", "scalar", scalar::Copy, 2},
+#if defined(__x86_64__)
+	  {"ntstore", "scalar", scalar::NtStore, 1},
+	  {"ntcopy", "scalar", scalar::NtCopy, 2},
+#endif
+	  {"scale", "scalar", scalar::Scale, 2},
+	  {"add", "scalar", scalar::Add, 3},
+	  {"triad", "scalar", scalar::Triad, 3},
+#if defined(__x86_64__)
+#define NVSL_STREAM_KERNEL_ENTRIES(ISA)		\
+	  {"load", #ISA, ISA::Load, 1},			\
+	  {"ntload", #ISA, ISA::NtLoad, 1},		\
+	  {"store", #ISA, ISA::Store, 1},		\
+	  {"ntstore", #ISA, ISA::NtStore, 1},		\
+	  {"copy", #ISA, ISA::Copy, 2},			\
+	  {"ntcopy", #ISA, ISA::NtCopy, 2},		\
+	  {"scale", #ISA, ISA::Scale, 2},		\
+	  {"add", #ISA, ISA::Add, 3},			\
+	  {"triad", #ISA, ISA::Triad, 3}
+	  NVSL_STREAM_KERNEL_ENTRIES(sse2),
+	  NVSL_STREAM_KERNEL_ENTRIES(avx2),
+	  NVSL_STREAM_KERNEL_ENTRIES(avx512),
+#endif
+     };
+
+     // Whether this CPU can run kernel.
+     static bool CanRunStreamKernel(const StreamKernel & kernel) {
+	  std::string isa = kernel.isa;
+#if defined(__x86_64__)
+	  __builtin_cpu_init();
+	  if (isa == "sse2") {
+	       return std::string(kernel.name) != "ntload" || __builtin_cpu_supports("sse4.1");
+	  } else if (isa == "avx2") {
+	       return __builtin_cpu_supports("avx2");
+	  } else if (isa == "avx512") {
+	       return __builtin_cpu_supports("avx512f");
+	  }
+#endif
+	  return isa == "scalar";
+     }
+
+     // Look up "<name>" or "<name>:<isa>".  Without an isa, this picks the
+     // widest flavor the CPU can run.  Returns false if there's no such
+     // kernel or the CPU can't run it.
+     static bool FindStreamKernel(const std::string & spec, StreamKernel & found) {
+	  size_t colon = spec.find(':');
+	  std::string name = spec.substr(0, colon);
+	  std::string isa = colon == std::string::npos ? "" : spec.substr(colon + 1);
+	  bool ok = false;
+	  for(unsigned int i = 0; i < sizeof(StreamKernels) / sizeof(StreamKernels[0]); i++) {
+	       const StreamKernel & k = StreamKernels[i];
+	       if (name == k.name && (isa.empty() || isa == k.isa) && CanRunStreamKernel(k)) {
+		    found = k;
+		    ok = true;
+	       }
+	  }
+	  return ok;
+     }
+
+     // "<name>:<isa>" for every kernel this CPU can run, for usage
+     // messages.
+     static std::string StreamKernelNames() {
+	  std::string names;
+	  for(unsigned int i = 0; i < sizeof(StreamKernels) / sizeof(StreamKernels[0]); i++) {
+	       if (CanRunStreamKernel(StreamKernels[i])) {
+		    names += std::string(names.empty() ? "" : " ") + StreamKernels[i].name + ":" + StreamKernels[i].isa;
+	       }
+	  }
+	  return names;
+     }
+}
+#endif
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include "HarnessCompare.hpp"
+
+/***
+
+    Compare two results files (any -format, e.g., from -out) the way
+    -baseline does, without rerunning anything:
+
+      compare_results.exe <baseline> <results> [-threshold <pct>]
+
+    Every result in <results> is matched with the same configuration in
+    <baseline>.  Exits 1 if any of them regressed by more than <pct>
+    percent (5 by default) and the change is significant, and 2 if a
+    file can't be read.
+
+***/
+
+int main(int argc, char *argv[]) {
+     double thresholdPct = 5;
+     std::vector<std::string> files;
+     for(int i = 1; i < argc; i++) {
+	  if (!strcmp(argv[i], "-threshold") && i + 1 < argc) {
+	       thresholdPct = atof(argv[++i]);
+	  } else {
+	       files.push_back(argv[i]);
+	  }
+     }
+     if (files.size() != 2) {
+	  std::cerr << "Usage: " << argv[0] << " <baseline> <results> [-threshold <pct>]\n";
+	  return 2;
+     }
+
+     std::vector<nvsl::ResultRow> baseline;
+     std::vector<nvsl::ResultRow> results;
+     for(unsigned int i = 0; i < files.size(); i++) {
+	  if (!nvsl::ReadResults(files[i], i == 0 ? baseline : results)) {
+	       std::cerr << "Can't read " << files[i] << "\n";
+	       return 2;
+	  }
+     }
+
+     unsigned int compared = 0;
+     unsigned int regressions = 0;
+     for(unsigned int i = 0; i < results.size(); i++) {
+	  if (!nvsl::IsComparable(results[i])) {
+	       continue;
+	  }
+	  const nvsl::ResultRow * before = nvsl::FindBaseline(baseline, results[i]);
+	  if (before == NULL || !nvsl::IsComparable(*before)) {
+	       std::cout << "no baseline " << nvsl::ResultKey(results[i]) << "\n";
+	       continue;
+	  }
+	  nvsl::Comparison c = nvsl::CompareResults(*before, results[i], thresholdPct);
+	  std::cout << nvsl::DescribeComparison(c) << "\n";
+	  compared++;
+	  if (c.verdict < 0) {
+	       regressions++;
+	  }
+     }
+     std::cout << regressions << " of " << compared << " configurations regressed by more than " << thresholdPct << "%\n";
+     return regressions > 0 ? 1 : 0;
+}
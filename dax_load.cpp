@@ -3,6 +3,7 @@
 #include <libpmem.h>
 #include <vector>
 #include <assert.h>
+#include "StreamKernels.hpp"
 
 #define MIN_HEAP_SIZE       64 // MB
 #define CACHE_LINE_WIDTH    64 // Bytes
@@ -10,21 +11,20 @@
 using namespace std;
 using namespace nvsl;
 
-// Global barriers
-nvsl::Barrier *startBarrier;
-nvsl::Barrier *endBarrier;
-nvsl::Barrier *runBarrier;
-
 // Global variables
 size_t accessSize = CACHE_LINE_WIDTH;
 enum AccessMode {
     RandomAccess = 0,
     SequentialAccess = 1
 } accessMode = SequentialAccess;
+// -k: read each block with one of the StreamKernels.hpp kernels instead
+// of the plain copy loop.
+string kernelName;
+StreamKernel kernel = {NULL, NULL, NULL, 0};
 
 void ParseOptions(int argc, char **argv) {
     int c;
-    while ((c = getopt(argc, argv, "m:g:")) != -1) {
+    while ((c = getopt(argc, argv, "m:g:k:")) != -1) {
         switch (c) {
             case 'm':
                 if (strcmp("rnd", optarg) == 0) {
@@ -42,11 +42,30 @@ void ParseOptions(int argc, char **argv) {
                 accessSize = atoi(optarg);
                 assert(accessSize % CACHE_LINE_WIDTH == 0);
                 break;
+            case 'k':
+                kernelName = optarg;
+                if (!FindStreamKernel(kernelName, kernel) ||
+                        (kernel.arrays != 1 && strcmp(kernel.name, "copy") && strcmp(kernel.name, "ntcopy")) ||
+                        !strcmp(kernel.name, "store") || !strcmp(kernel.name, "ntstore")) {
+                    fprintf(stderr, "-k must be load, ntload, copy or ntcopy, optionally with :<isa>.  This CPU has %s\n",
+                            StreamKernelNames().c_str());
+                    exit(EXIT_FAILURE);
+                }
+                break;
             default:
                 fprintf(stderr, "Unexpected argument: %c\n", c);
                 exit(EXIT_FAILURE);
         }
     }
+
+    // Record our options so they show up in the results.
+    // -dist only means something for random blocks.
+    if (MicroBenchmarkHarness::IsDistributionSet()) {
+        accessMode = RandomAccess;
+    }
+    MicroBenchmarkHarness::RecordOption("mode", accessMode == RandomAccess ? "rnd" : "seq");
+    MicroBenchmarkHarness::RecordOption("accessBytes", accessSize);
+    MicroBenchmarkHarness::RecordOption("kernel", kernel.run ? string(kernel.name) + ":" + kernel.isa : "loop");
 }
 
 class ThreadArgs {
@@ -70,21 +89,33 @@ public:
     }
 };
 
-void random_read(ThreadArgs *args) {
-    uint64_t block = (uint64_t)RandLFSR(&args->seed) % args->totalBlocks;
-    uint64_t *ptr = (uint64_t *)((char *)args->viewPtr + block * accessSize);
+// Read one block: copy it to our DRAM buffer, or with -k, run the
+// kernel over it (load kernels just read it).
+inline void read_block(ThreadArgs *args, uint64_t *ptr) {
+    if (kernel.run != NULL) {
+        if (kernel.arrays == 1) {
+            kernel.run((char *)ptr, NULL, NULL, accessSize);
+        } else {
+            kernel.run((char *)args->buffer, (const char *)ptr, NULL, accessSize);
+        }
+        return;
+    }
     for (uint64_t i = 0; i < args->quadWordsPerBlock; i++) {
         args->buffer[i] = ptr[i];
     }
 }
 
+void random_read(ThreadArgs *args) {
+    uint64_t block = MicroBenchmarkHarness::GetDistribution().Pick(args->seed);
+    uint64_t *ptr = (uint64_t *)((char *)args->viewPtr + block * accessSize);
+    read_block(args, ptr);
+}
+
 void sequential_read(ThreadArgs *args) {
     uint64_t block = args->lastReadBlock;
     args->lastReadBlock = (args->lastReadBlock + accessSize) % args->totalBlocks;
     uint64_t *ptr = (uint64_t *)((char *)args->viewPtr + block * accessSize);
-    for (uint64_t i = 0; i < args->quadWordsPerBlock; i++) {
-        args->buffer[i] = ptr[i];
-    }
+    read_block(args, ptr);
 }
 
 void *go(void *arg) {
@@ -92,37 +123,37 @@ void *go(void *arg) {
     ThreadArgs *args = reinterpret_cast<ThreadArgs *>(arg);
 
     // Prepare thread environment
-    uint64_t opCount = MicroBenchmarkHarness::GetOperationCountPerThread();
     void (*fptr)(ThreadArgs *) = &sequential_read;
     if (accessMode == RandomAccess) fptr = &random_read;
 
-    // Wait for other threads
-    startBarrier->Join();
-
-    // If you are the first thread, start timing
-    if (args->threadID == 0) {
-        MicroBenchmarkHarness::StartTiming();
-    }
-
-    runBarrier->Join();
-
-    // Run benchmark
-    uint64_t c = 0;
-    if (opCount == 0) { // Fixed time frame
-        while (!MicroBenchmarkHarness::isDone()) {
-            fptr(args);
-            c++;
+    // Warmup (if any) and trials.  BeginTrial() waits for the other
+    // threads and starts timing.
+    for (int trial = MicroBenchmarkHarness::FirstTrial();
+         trial < MicroBenchmarkHarness::GetTrialCount(); trial++) {
+        MicroBenchmarkHarness::BeginTrial(args->threadID, trial);
+        uint64_t opCount = MicroBenchmarkHarness::GetOperationCountPerThread(args->threadID);
+
+        // Ops are counted as they finish (in this thread's own counter) so
+        // -interval can see throughput change during the run.
+        if (MicroBenchmarkHarness::GetOperationCount() == 0) { // Fixed time frame
+            while (!MicroBenchmarkHarness::isDone()) {
+                uint64_t start = MicroBenchmarkHarness::OpStart(args->threadID);
+                fptr(args);
+                MicroBenchmarkHarness::LatencyEnd(args->threadID, start);
+                MicroBenchmarkHarness::CompletedOperations(args->threadID, 1);
+            }
         }
-    }
-    else { // Fixed operations
-        for (uint64_t i = 0; i < opCount; i++) {
-            fptr(args);
+        else { // Fixed operations
+            for (uint64_t i = 0; i < opCount; i++) {
+                uint64_t start = MicroBenchmarkHarness::OpStart(args->threadID);
+                fptr(args);
+                MicroBenchmarkHarness::LatencyEnd(args->threadID, start);
+                MicroBenchmarkHarness::CompletedOperations(args->threadID, 1);
+            }
         }
-        c = opCount;
-    }
 
-    MicroBenchmarkHarness::CompletedOperations(c);
-    endBarrier->Join();
+        MicroBenchmarkHarness::EndTrial(args->threadID, trial);
+    }
 
     return NULL;
 }
@@ -134,61 +165,80 @@ int main(int argc, char **argv) {
 
     // Configure benchmark
     ParseOptions(argc, argv);
-    assert(MicroBenchmarkHarness::GetFootPrintMB() >= MIN_HEAP_SIZE);
-    size_t nvHeapLen = MicroBenchmarkHarness::GetFootPrintBytes();
+    MicroBenchmarkHarness::SetBytesPerOp(accessSize);
     string nvHeapPath = MicroBenchmarkHarness::GetFileName();
     assert(nvHeapPath.length() > 0);
 
-    // Create persistent heap
+    // Create persistent heap.  Creating it is slow, so map it once, big
+    // enough for the largest footprint in a sweep, and have each point
+    // use the first GetFootPrintBytes() of it.
     int isPMEM;
-    size_t nvMapLen;
-    void *nvHeapPtr = pmem_map_file(nvHeapPath.c_str(), nvHeapLen,
-            PMEM_FILE_CREATE | PMEM_FILE_EXCL, 0666, &nvMapLen, &isPMEM);
+    size_t nvHeapMaxLen = MicroBenchmarkHarness::GetMaxFootPrintBytes();
+    size_t nvHeapMapLen;
+    void *nvHeapPtr = pmem_map_file(nvHeapPath.c_str(), nvHeapMaxLen,
+            PMEM_FILE_CREATE | PMEM_FILE_EXCL, 0666, &nvHeapMapLen, &isPMEM);
     assert(nvHeapPtr != NULL);
-    assert(nvMapLen == nvHeapLen);
+    assert(nvHeapMapLen == nvHeapMaxLen);
     //assert(isPMEM != 0); TODO
-
-    // Prepare environment
-    unsigned int threadCount = MicroBenchmarkHarness::GetThreadCount();
-    startBarrier = new nvsl::Barrier(threadCount);
-    endBarrier = new nvsl::Barrier(threadCount);
-    runBarrier = new nvsl::Barrier(threadCount);
-
-    // Prepare configurations
-    vector<ThreadArgs *> threadArgs;
-    for (unsigned int i = 0; i < threadCount; i++) {
-        ThreadArgs *t = new ThreadArgs;
-        t->threadID = i;
-        t->viewPtr = nvHeapPtr;
-        t->viewLen = nvMapLen;
-        t->seed = i;
-        t->buffer = (uint64_t *)malloc(accessSize);
-        t->lastReadBlock = 0;
-        t->totalBlocks = nvMapLen / accessSize;
-        t->quadWordsPerBlock = accessSize / sizeof(uint64_t);
-        threadArgs.push_back(t);
-        //t->Print();
+    // -cold clflush flushes it before each trial.
+    MicroBenchmarkHarness::AddColdRegion(nvHeapPtr, nvHeapMaxLen);
+
+    // DRAM buffers for each thread, from the harness so they're faulted
+    // in (and on -pages pages) before the timed part.  Shared by every
+    // point of the sweep.
+    vector<uint64_t *> buffers;
+    for (unsigned int i = 0; i < MicroBenchmarkHarness::GetMaxThreadCount(); i++) {
+        buffers.push_back((uint64_t *)MicroBenchmarkHarness::AllocateBuffer(accessSize));
     }
 
-    // Create benchmark threads
-    for (unsigned int i = 0; i < threadCount; i++) {
-        MicroBenchmarkHarness::StartThread(go,
-                reinterpret_cast<void *>(threadArgs[i]));
-    }
+    // Once for each -tc and -foot in the sweep.
+    do {
+        assert(MicroBenchmarkHarness::GetFootPrintMB() >= MIN_HEAP_SIZE);
+        size_t nvHeapLen = MicroBenchmarkHarness::GetFootPrintBytes();
+        size_t nvMapLen = nvHeapLen;
+
+        // Prepare environment
+        unsigned int threadCount = MicroBenchmarkHarness::GetThreadCount();
+
+        // Which blocks random accesses go to (-dist).
+        MicroBenchmarkHarness::GetDistribution().Build(nvMapLen / accessSize);
+
+        // Prepare configurations
+        vector<ThreadArgs *> threadArgs;
+        for (unsigned int i = 0; i < threadCount; i++) {
+            ThreadArgs *t = new ThreadArgs;
+            t->threadID = i;
+            t->viewPtr = nvHeapPtr;
+            t->viewLen = nvMapLen;
+            t->seed = MicroBenchmarkHarness::ThreadSeed(i);
+            t->buffer = buffers[i];
+            t->lastReadBlock = 0;
+            t->totalBlocks = nvMapLen / accessSize;
+            t->quadWordsPerBlock = accessSize / sizeof(uint64_t);
+            threadArgs.push_back(t);
+            //t->Print();
+        }
+
+        // Create benchmark threads
+        for (unsigned int i = 0; i < threadCount; i++) {
+            MicroBenchmarkHarness::StartThread(go,
+                    reinterpret_cast<void *>(threadArgs[i]));
+        }
 
-    // Wait for threads to terminate
-    MicroBenchmarkHarness::WaitForThreads();
-    MicroBenchmarkHarness::StopTiming();
-    MicroBenchmarkHarness::PrintResults();
+        // Wait for threads to terminate
+        MicroBenchmarkHarness::WaitForThreads();
+        MicroBenchmarkHarness::StopTiming();
+        MicroBenchmarkHarness::PrintResults();
+
+        for (unsigned int i = 0; i < threadCount; i++) {
+            ThreadArgs *t = threadArgs.back();
+            threadArgs.pop_back();
+            delete t;
+        }
+    } while (MicroBenchmarkHarness::NextSweepPoint());
 
     // Clean-up
-    pmem_unmap(nvHeapPtr, nvMapLen);
-    for (unsigned int i = 0; i < threadCount; i++) {
-        ThreadArgs *t = threadArgs.back();
-        threadArgs.pop_back();
-        free(t->buffer);
-        delete t;
-    }
+    pmem_unmap(nvHeapPtr, nvHeapMapLen);
 
-    return 0;
+    return MicroBenchmarkHarness::GetExitStatus();
 }
@@ -3,6 +3,7 @@
 #include <libpmem.h>
 #include <vector>
 #include <assert.h>
+#include "StreamKernels.hpp"
 
 #define MIN_HEAP_SIZE       64 // MB
 #define CACHE_LINE_WIDTH    64 // Bytes
@@ -10,11 +11,6 @@
 using namespace std;
 using namespace nvsl;
 
-// Global barriers
-nvsl::Barrier *startBarrier;
-nvsl::Barrier *endBarrier;
-nvsl::Barrier *runBarrier;
-
 // Global variables
 size_t accessSize = CACHE_LINE_WIDTH;
 enum AccessMode {
@@ -28,10 +24,14 @@ enum StoreMode {
     NonTempStoreNoBarrier = 3,
     NonTempStoreAndBarrier = 4
 } storeMode = StoreNoBarrier;
+// -k: write each block with one of the StreamKernels.hpp kernels
+// instead of the copy -s picks (-s still picks the barrier).
+string kernelName;
+StreamKernel kernel = {NULL, NULL, NULL, 0};
 
 void ParseOptions(int argc, char **argv) {
     int c;
-    while ((c = getopt(argc, argv, "m:g:s:")) != -1) {
+    while ((c = getopt(argc, argv, "m:g:s:k:")) != -1) {
         switch (c) {
             case 'm':
                 if (strcmp("rnd", optarg) == 0) {
@@ -70,11 +70,33 @@ void ParseOptions(int argc, char **argv) {
                             optarg);
                 }
                 break;
+            case 'k':
+                kernelName = optarg;
+                if (!FindStreamKernel(kernelName, kernel) ||
+                        (strcmp(kernel.name, "store") && strcmp(kernel.name, "ntstore") &&
+                         strcmp(kernel.name, "copy") && strcmp(kernel.name, "ntcopy"))) {
+                    fprintf(stderr, "-k must be store, ntstore, copy or ntcopy, optionally with :<isa>.  This CPU has %s\n",
+                            StreamKernelNames().c_str());
+                    exit(EXIT_FAILURE);
+                }
+                break;
             default:
                 fprintf(stderr, "Unexpected argument: %c\n", c);
                 exit(EXIT_FAILURE);
         }
     }
+
+    // Record our options so they show up in the results.
+    static const char *storeModes[] = {"no-barrier", "barrier", "flush",
+                                       "nstore-no-barrier", "nstore-barrier"};
+    // -dist only means something for random blocks.
+    if (MicroBenchmarkHarness::IsDistributionSet()) {
+        accessMode = RandomAccess;
+    }
+    MicroBenchmarkHarness::RecordOption("mode", accessMode == RandomAccess ? "rnd" : "seq");
+    MicroBenchmarkHarness::RecordOption("accessBytes", accessSize);
+    MicroBenchmarkHarness::RecordOption("store", storeModes[storeMode]);
+    MicroBenchmarkHarness::RecordOption("kernel", kernel.run ? string(kernel.name) + ":" + kernel.isa : "loop");
 }
 
 // Barrier functions
@@ -107,6 +129,12 @@ void *fast_memcpy(void *dst, const void *src, size_t size) {
     return dst;
 }
 
+// The -k kernel, as a memcpy.  store and ntstore ignore src.
+void *kernel_memcpy(void *dst, const void *src, size_t size) {
+    kernel.run((char *)dst, (const char *)src, NULL, size);
+    return dst;
+}
+
 class ThreadArgs {
 public:
     unsigned int threadID;
@@ -121,7 +149,7 @@ public:
 };
 
 void random_write(ThreadArgs *args) {
-    uint64_t block = (uint64_t)RandLFSR(&args->seed) % args->totalBlocks;
+    uint64_t block = MicroBenchmarkHarness::GetDistribution().Pick(args->seed);
     uint64_t *ptr = (uint64_t *)((char *)args->viewPtr + block * accessSize);
     args->memcpyPtr(ptr, args->buffer, accessSize);
     args->barrierPtr(ptr, accessSize);
@@ -140,37 +168,37 @@ void *go(void *arg) {
     ThreadArgs *args = reinterpret_cast<ThreadArgs *>(arg);
 
     // Prepare thread environment
-    uint64_t opCount = MicroBenchmarkHarness::GetOperationCountPerThread();
     void (*fptr)(ThreadArgs *) = &sequential_write;
     if (accessMode == RandomAccess) fptr = &random_write;
 
-    // Wait for other threads
-    startBarrier->Join();
-
-    // If you are the first thread, start timing
-    if (args->threadID == 0) {
-        MicroBenchmarkHarness::StartTiming();
-    }
-
-    runBarrier->Join();
-
-    // Run benchmark
-    uint64_t c = 0;
-    if (opCount == 0) { // Fixed time frame
-        while (!MicroBenchmarkHarness::isDone()) {
-            fptr(args);
-            c++;
+    // Warmup (if any) and trials.  BeginTrial() waits for the other
+    // threads and starts timing.
+    for (int trial = MicroBenchmarkHarness::FirstTrial();
+         trial < MicroBenchmarkHarness::GetTrialCount(); trial++) {
+        MicroBenchmarkHarness::BeginTrial(args->threadID, trial);
+        uint64_t opCount = MicroBenchmarkHarness::GetOperationCountPerThread(args->threadID);
+
+        // Ops are counted as they finish (in this thread's own counter) so
+        // -interval can see throughput change during the run.
+        if (MicroBenchmarkHarness::GetOperationCount() == 0) { // Fixed time frame
+            while (!MicroBenchmarkHarness::isDone()) {
+                uint64_t start = MicroBenchmarkHarness::OpStart(args->threadID);
+                fptr(args);
+                MicroBenchmarkHarness::LatencyEnd(args->threadID, start);
+                MicroBenchmarkHarness::CompletedOperations(args->threadID, 1);
+            }
         }
-    }
-    else { // Fixed operations
-        for (uint64_t i = 0; i < opCount; i++) {
-            fptr(args);
+        else { // Fixed operations
+            for (uint64_t i = 0; i < opCount; i++) {
+                uint64_t start = MicroBenchmarkHarness::OpStart(args->threadID);
+                fptr(args);
+                MicroBenchmarkHarness::LatencyEnd(args->threadID, start);
+                MicroBenchmarkHarness::CompletedOperations(args->threadID, 1);
+            }
         }
-        c = opCount;
-    }
 
-    MicroBenchmarkHarness::CompletedOperations(c);
-    endBarrier->Join();
+        MicroBenchmarkHarness::EndTrial(args->threadID, trial);
+    }
 
     return NULL;
 }
@@ -182,84 +210,106 @@ int main(int argc, char **argv) {
 
     // Configure benchmark
     ParseOptions(argc, argv);
-    assert(MicroBenchmarkHarness::GetFootPrintMB() >= MIN_HEAP_SIZE);
-    size_t nvHeapLen = MicroBenchmarkHarness::GetFootPrintBytes();
+    MicroBenchmarkHarness::SetBytesPerOp(accessSize);
     string nvHeapPath = MicroBenchmarkHarness::GetFileName();
     assert(nvHeapPath.length() > 0);
 
-    // Create persistent heap
+    // Create persistent heap.  Creating it is slow, so map it once, big
+    // enough for the largest footprint in a sweep, and have each point
+    // use the first GetFootPrintBytes() of it.
     int isPMEM;
-    size_t nvMapLen;
-    void *nvHeapPtr = pmem_map_file(nvHeapPath.c_str(), nvHeapLen,
-            PMEM_FILE_CREATE | PMEM_FILE_EXCL, 0666, &nvMapLen, &isPMEM);
+    size_t nvHeapMaxLen = MicroBenchmarkHarness::GetMaxFootPrintBytes();
+    size_t nvHeapMapLen;
+    void *nvHeapPtr = pmem_map_file(nvHeapPath.c_str(), nvHeapMaxLen,
+            PMEM_FILE_CREATE | PMEM_FILE_EXCL, 0666, &nvHeapMapLen, &isPMEM);
     assert(nvHeapPtr != NULL);
-    assert(nvMapLen == nvHeapLen);
+    assert(nvHeapMapLen == nvHeapMaxLen);
     //assert(isPMEM != 0); TODO
+    // -cold clflush flushes it before each trial.
+    MicroBenchmarkHarness::AddColdRegion(nvHeapPtr, nvHeapMaxLen);
+
+    // DRAM buffers for each thread, from the harness so they're faulted
+    // in (and on -pages pages) before the timed part.  Shared by every
+    // point of the sweep.
+    vector<uint64_t *> buffers;
+    for (unsigned int i = 0; i < MicroBenchmarkHarness::GetMaxThreadCount(); i++) {
+        buffers.push_back((uint64_t *)MicroBenchmarkHarness::AllocateBuffer(accessSize));
+    }
 
-    // Prepare environment
-    unsigned int threadCount = MicroBenchmarkHarness::GetThreadCount();
-    startBarrier = new nvsl::Barrier(threadCount);
-    endBarrier = new nvsl::Barrier(threadCount);
-    runBarrier = new nvsl::Barrier(threadCount);
+    // Once for each -tc and -foot in the sweep.
+    do {
+        assert(MicroBenchmarkHarness::GetFootPrintMB() >= MIN_HEAP_SIZE);
+        size_t nvHeapLen = MicroBenchmarkHarness::GetFootPrintBytes();
+        size_t nvMapLen = nvHeapLen;
 
-    void *(*memcpyPtr)(void *, const void *, size_t) = fast_memcpy;
-    if (storeMode == NonTempStoreNoBarrier || storeMode == NonTempStoreAndBarrier) {
-        memcpyPtr = pmem_memcpy_nodrain;
-    }
-    void (*barrierPtr)(void *, size_t) = barrier_empty;
-    if (storeMode == StoreAndBarrier || storeMode == NonTempStoreAndBarrier) {
-        barrierPtr = barrier_sfence;
-    }
-    else if (storeMode == StoreAndFlush) {
-        barrierPtr = barrier_flush;
-    }
+        // Prepare environment
+        unsigned int threadCount = MicroBenchmarkHarness::GetThreadCount();
 
-    /*
-     * Preventing back contention
-     * The issue is concurrent requests from different threads all going to the same
-     * memory bank. This would results in poor sequential throughput for high thread
-     * counts.
-     * We set a different start offset for each worker thread to make sure they write
-     * to different regions of persistent memory.
-     */
-    size_t sectionSize = nvHeapLen / threadCount;
-    assert(sectionSize % CACHE_LINE_WIDTH == 0);
-
-    // Prepare configurations
-    vector<ThreadArgs *> threadArgs;
-    for (unsigned int i = 0; i < threadCount; i++) {
-        ThreadArgs *t = new ThreadArgs;
-        t->threadID = i;
-        t->viewPtr = nvHeapPtr;
-        t->viewLen = nvMapLen;
-        t->seed = i;
-        t->buffer = (uint64_t *)malloc(accessSize);
-        t->memcpyPtr = memcpyPtr;
-        t->barrierPtr = barrierPtr;
-        t->nextBlockToWrite = i * sectionSize;
-        t->totalBlocks = nvMapLen / accessSize;
-        threadArgs.push_back(t);
-    }
+        void *(*memcpyPtr)(void *, const void *, size_t) = fast_memcpy;
+        if (storeMode == NonTempStoreNoBarrier || storeMode == NonTempStoreAndBarrier) {
+            memcpyPtr = pmem_memcpy_nodrain;
+        }
+        if (kernel.run != NULL) {
+            memcpyPtr = kernel_memcpy;
+        }
+        void (*barrierPtr)(void *, size_t) = barrier_empty;
+        if (storeMode == StoreAndBarrier || storeMode == NonTempStoreAndBarrier) {
+            barrierPtr = barrier_sfence;
+        }
+        else if (storeMode == StoreAndFlush) {
+            barrierPtr = barrier_flush;
+        }
 
-    // Create benchmark threads
-    for (unsigned int i = 0; i < threadCount; i++) {
-        MicroBenchmarkHarness::StartThread(go,
-                reinterpret_cast<void *>(threadArgs[i]));
-    }
+        /*
+         * Preventing back contention
+         * The issue is concurrent requests from different threads all going to the same
+         * memory bank. This would results in poor sequential throughput for high thread
+         * counts.
+         * We set a different start offset for each worker thread to make sure they write
+         * to different regions of persistent memory.
+         */
+        size_t sectionSize = nvHeapLen / threadCount;
+        assert(sectionSize % CACHE_LINE_WIDTH == 0);
+
+        // Which blocks random accesses go to (-dist).
+        MicroBenchmarkHarness::GetDistribution().Build(nvMapLen / accessSize);
+
+        // Prepare configurations
+        vector<ThreadArgs *> threadArgs;
+        for (unsigned int i = 0; i < threadCount; i++) {
+            ThreadArgs *t = new ThreadArgs;
+            t->threadID = i;
+            t->viewPtr = nvHeapPtr;
+            t->viewLen = nvMapLen;
+            t->seed = MicroBenchmarkHarness::ThreadSeed(i);
+            t->buffer = buffers[i];
+            t->memcpyPtr = memcpyPtr;
+            t->barrierPtr = barrierPtr;
+            t->nextBlockToWrite = i * sectionSize;
+            t->totalBlocks = nvMapLen / accessSize;
+            threadArgs.push_back(t);
+        }
+
+        // Create benchmark threads
+        for (unsigned int i = 0; i < threadCount; i++) {
+            MicroBenchmarkHarness::StartThread(go,
+                    reinterpret_cast<void *>(threadArgs[i]));
+        }
 
-    // Wait for threads to terminate
-    MicroBenchmarkHarness::WaitForThreads();
-    MicroBenchmarkHarness::StopTiming();
-    MicroBenchmarkHarness::PrintResults();
+        // Wait for threads to terminate
+        MicroBenchmarkHarness::WaitForThreads();
+        MicroBenchmarkHarness::StopTiming();
+        MicroBenchmarkHarness::PrintResults();
+
+        for (unsigned int i = 0; i < threadCount; i++) {
+            ThreadArgs *t = threadArgs.back();
+            threadArgs.pop_back();
+            delete t;
+        }
+    } while (MicroBenchmarkHarness::NextSweepPoint());
 
     // Clean-up
-    pmem_unmap(nvHeapPtr, nvMapLen);
-    for (unsigned int i = 0; i < threadCount; i++) {
-        ThreadArgs *t = threadArgs.back();
-        threadArgs.pop_back();
-        free(t->buffer);
-        delete t;
-    }
+    pmem_unmap(nvHeapPtr, nvHeapMapLen);
 
-    return 0;
+    return MicroBenchmarkHarness::GetExitStatus();
 }
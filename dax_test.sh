@@ -2,7 +2,9 @@
 
 MNTPOINT="/mnt/pmem12"
 HEAP_PATH="$MNTPOINT/heap"
-RUN_TIME=60 # Sec
+WINDOW=2 # Sec per trial
+PRECISION=1 # Stop once the 95% CI is within this % of the mean...
+MAX_TIME=60 # Sec, ...or after this much measuring
 FOOT=81920 # 80 GB
 
 TEST1=`mount | grep $MNTPOINT`
@@ -22,16 +24,17 @@ fi
 
 echo "Running benchmark at $HEAP_PATH, device $DEV"
 
-for TC in 1 2 4 8 16 32 64; do
-    for M in 'rnd' 'seq'; do
-        for G in 64 128 256 512 1024 2048 4096 8192; do
-            rm -rf $HEAP_PATH
-            ./dax_load.exe $M/$G -tc $TC -footMB $FOOT -rt $RUN_TIME -file $HEAP_PATH -m $M -g $G
+# Every thread count runs in one process, against one heap.
+TC=1..64x2
+
+for M in 'rnd' 'seq'; do
+    for G in 64 128 256 512 1024 2048 4096 8192; do
+        rm -rf $HEAP_PATH
+        ./dax_load.exe $M/$G -tc $TC -footMB $FOOT -rt $WINDOW -converge $PRECISION -maxRunTime $MAX_TIME -file $HEAP_PATH -m $M -g $G
 
-            for SM in 'no-barrier' 'barrier' 'flush' 'nstore-no-barrier' 'nstore-barrier'; do
-                rm -rf $HEAP_PATH
-                ./dax_store.exe $M/$G/$SM -tc $TC -footMB $FOOT -rt $RUN_TIME -file $HEAP_PATH -m $M -g $G -s $SM
-            done
+        for SM in 'no-barrier' 'barrier' 'flush' 'nstore-no-barrier' 'nstore-barrier'; do
+            rm -rf $HEAP_PATH
+            ./dax_store.exe $M/$G/$SM -tc $TC -footMB $FOOT -rt $WINDOW -converge $PRECISION -maxRunTime $MAX_TIME -file $HEAP_PATH -m $M -g $G -s $SM
         done
     done
 done
@@ -26,7 +26,13 @@ std::string filepath = "/mnt/ramdisk/";
 int pageSize = 4096;
 int numFiles = 1;
 std::string newFilePath = "/mnt/ramdisk/";
+// -o: the ops to run, in order.  With more than one, each is a phase
+// (see BeginPhase()) and gets its own row in the results.
+std::vector<file_operations> fileOps(1, createOp);
+std::string fileOpList = "0";
+const char * opNames[] = {"create", "create_write", "rename"};
 file_operations fileOp  = createOp;
+unsigned int fileOpIndex = 0;
 
 // Parse our custom options on the command line.
 // d - directory/file path
@@ -38,9 +44,22 @@ void ParseOptions(int & argc, char  *argv[])
      /* process arguments */
      while ((c = getopt(argc, argv, "o:d:n:f:")) != -1) {
           switch (c) {
-	  case 'o':
-		fileOp = static_cast<file_operations>(atoi(optarg));
+	  case 'o': {
+		// A comma separated list, e.g., "0,2" to create, then rename.
+		fileOpList = optarg;
+		fileOps.clear();
+		std::stringstream ops(fileOpList);
+		std::string op;
+		while (std::getline(ops, op, ',')) {
+		     int o = atoi(op.c_str());
+		     if (o < createOp || o > renameOp) {
+			  fprintf(stderr, "Unknown op %d\n", o);
+			  exit(EXIT_FAILURE);
+		     }
+		     fileOps.push_back(static_cast<file_operations>(o));
+		}
 		break;
+	  }
 	  case 'd':
 	       filepath = optarg;
 	       break;
@@ -55,6 +74,19 @@ void ParseOptions(int & argc, char  *argv[])
                exit(EXIT_FAILURE);
           }
      }
+
+     // Each phase runs until it's out of files, so with -rt the ones
+     // after the first would have no time left.
+     if (fileOps.size() > 1 && nvsl::MicroBenchmarkHarness::GetOperationCount() == 0) {
+	  fprintf(stderr, "A list of ops (-o) needs -max\n");
+	  exit(EXIT_FAILURE);
+     }
+
+     // Record our options so they show up in the results.
+     nvsl::MicroBenchmarkHarness::RecordOption("op", fileOpList);
+     nvsl::MicroBenchmarkHarness::RecordOption("path", filepath);
+     nvsl::MicroBenchmarkHarness::RecordOption("numFiles", numFiles);
+     nvsl::MicroBenchmarkHarness::RecordOption("newPath", newFilePath);
 }
 
 // Little struct with the state our benchmark needs in each thread.
@@ -68,15 +100,9 @@ struct ThreadArgs {
      int id;
      int blockSize;
      char *buf;
+     bool renamed;
 };
 
-// Barriers to coordinate execution across threads.  The main goal is to make
-// sure that some threads don't start running before all of them have been
-// created.
-nvsl::Barrier *startBarrier;
-nvsl::Barrier *endBarrier;
-nvsl::Barrier *runBarrier;
-
 void fill_buffer(ThreadArgs * args) {
      char rbyte = (char)RandLFSR(&args->seed) % args->max_index;
      char *buf  = args->buf;
@@ -103,12 +129,27 @@ void fcreate_write(ThreadArgs *args) {
 	} 
 }
 
+// Every other pass renames the files back, so repeated passes (-rt,
+// -trials, sweeps) have files to rename.  If the first file isn't
+// there to rename (e.g., an earlier run left them renamed), go the
+// other way.
 void frename(ThreadArgs *args) {
-	for (int i = args->start_index; i <= args->end_index; i++) {
-	   std::string oldPath = args->fileName + patch::to_string(i);
-	   std::string newPath = args->newFileName + patch::to_string(i);
-	   if (rename(oldPath.c_str(), newPath.c_str()) < 0)
-		break;
+	for (int tries = 0; tries < 2; tries++) {
+	   const std::string & from = args->renamed ? args->newFileName : args->fileName;
+	   const std::string & to = args->renamed ? args->fileName : args->newFileName;
+	   int i;
+	   for (i = args->start_index; i <= args->end_index; i++) {
+	      std::string oldPath = from + patch::to_string(i);
+	      std::string newPath = to + patch::to_string(i);
+	      if (rename(oldPath.c_str(), newPath.c_str()) < 0)
+		   break;
+	   }
+	   if (i > args->start_index) {
+	      if (i > args->end_index)
+		   args->renamed = !args->renamed;
+	      return;
+	   }
+	   args->renamed = !args->renamed;
 	}
 }
 
@@ -119,9 +160,6 @@ void * go(void *arg) {
      // Recover this threads arguments.
      ThreadArgs * args = reinterpret_cast<ThreadArgs*>(arg);
 
-     // Grab the number of ops to perform per thread.
-     unsigned int threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread();
-
      void (*fptr)(ThreadArgs *);
      switch(fileOp) {
 	case createOp : fptr = &fcreate;
@@ -134,40 +172,44 @@ void * go(void *arg) {
 	default : fptr = &fcreate;
      }	
 
-     // Wait for the threads to be started.
-     startBarrier->Join();
-
-     // If you we are the first thread, start timing.
-     if (args->id == 0) {
-          nvsl::MicroBenchmarkHarness::StartTiming();
-     }
-
-     // ready, set, ....
-     runBarrier->Join();
-
-     //Go !
-     if (threadOps == 0) { // Running for a fixed period of time.
-
-	  uint64_t c = 0;
-	  // isDone() checks a couple of termination conditions including
-	  while(!nvsl::MicroBenchmarkHarness::isDone()) {
-	       fptr(args);
-	       c++;
-	  }
-	  // Tell the system how many operations we completed.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(c);
-     } else { // running for a fixed number of ops.
-
-	  // Run the number of ops we should run.
-	  for(unsigned int i = 0; i < threadOps; i++) {
-	       fptr(args);
+     // Run the warmup (if any) and each trial of this op.  BeginTrial()
+     // waits for all the threads and starts the clock (and with -cold,
+     // e.g., -cold drop, starts with no cached dentries), and
+     // EndTrial() records the trial.
+     for(int trial = nvsl::MicroBenchmarkHarness::FirstTrial();
+	 trial < nvsl::MicroBenchmarkHarness::GetTrialCount();
+	 trial++) {
+	  nvsl::MicroBenchmarkHarness::BeginTrial(args->id, trial);
+
+	  // Grab the number of ops to perform per thread (the warmup has
+	  // its own count).
+	  unsigned long long threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread(args->id);
+
+	  //Go !
+	  if (nvsl::MicroBenchmarkHarness::GetOperationCount() == 0) { // Running for a fixed period of time.
+
+	       // isDone() checks a couple of termination conditions including
+	       while(!nvsl::MicroBenchmarkHarness::isDone()) {
+		    uint64_t start = nvsl::MicroBenchmarkHarness::OpStart(args->id);
+		    fptr(args);
+		    nvsl::MicroBenchmarkHarness::LatencyEnd(args->id, start);
+		    // Count each op as it finishes so -interval can see our
+		    // progress.  It's our own counter, so this is cheap.
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, 1);
+	       }
+	  } else { // running for a fixed number of ops.
+
+	       // Run the number of ops we should run.
+	       for(unsigned long long i = 0; i < threadOps; i++) {
+		    uint64_t start = nvsl::MicroBenchmarkHarness::OpStart(args->id);
+		    fptr(args);
+		    nvsl::MicroBenchmarkHarness::LatencyEnd(args->id, start);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, 1);
+	       }
 	  }
-	  // Tell the harness.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(threadOps);
 
+	  nvsl::MicroBenchmarkHarness::EndTrial(args->id, trial);
      }
-
-     endBarrier->Join();
      return NULL;
 }
 
@@ -184,11 +226,8 @@ int main (int argc, char *argv[]) {
      // parse our custom options
      ParseOptions(argc, argv);
 
-     // get thread count and create the barriers.
-     uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
-     startBarrier = new nvsl::Barrier(thread_count);
-     endBarrier = new nvsl::Barrier(thread_count);
-     runBarrier = new nvsl::Barrier(thread_count);
+     // Enough threads for the biggest -tc in a sweep.
+     uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetMaxThreadCount();
 
      typedef std::vector<ThreadArgs* > ArgsList;
 
@@ -205,7 +244,7 @@ int main (int argc, char *argv[]) {
 	ThreadArgs * t = new ThreadArgs;
 	char *buf = (char *)valloc(pageSize);
 	t->max_index = 255;
-	t->seed = i;
+	t->seed = nvsl::MicroBenchmarkHarness::ThreadSeed(i);
 	t->id = i;
 	t->start_index = (last_used) + 1;
 	t->end_index   = last_used + numFiles;
@@ -213,22 +252,39 @@ int main (int argc, char *argv[]) {
 	t->newFileName = newFilePath + "dir" + patch::to_string(i+1) + "/f";
 	t->blockSize = pageSize;
 	t->buf = buf;
+	t->renamed = false;
 	fill_buffer(t);
 	argsList.push_back(t);
 	last_used += numFiles;
      }
 
-     for(unsigned int i= 0; i< thread_count; i++) {
-          nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
-     }
-
-     // wait for all threads to complete.
-     nvsl::MicroBenchmarkHarness::WaitForThreads();
-     nvsl::MicroBenchmarkHarness::StopTiming();
-     nvsl::MicroBenchmarkHarness::PrintResults();
+     // Once for each -tc and -foot in the sweep.  Each point works on
+     // the same files, so a sweep of creates only creates them once.
+     do {
+	thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
+
+	// Run each op on every thread, one op after the other.
+	for(fileOpIndex = 0; fileOpIndex < fileOps.size(); fileOpIndex++) {
+	     fileOp = fileOps[fileOpIndex];
+	     if (fileOps.size() > 1) {
+		  nvsl::MicroBenchmarkHarness::BeginPhase(opNames[fileOp]);
+	     }
+	     for(unsigned int i= 0; i< thread_count; i++) {
+		  nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
+	     }
+
+	     // wait for all threads to complete.
+	     nvsl::MicroBenchmarkHarness::WaitForThreads();
+	     if (fileOps.size() > 1) {
+		  nvsl::MicroBenchmarkHarness::EndPhase();
+	     }
+	}
+	nvsl::MicroBenchmarkHarness::StopTiming();
+	nvsl::MicroBenchmarkHarness::PrintResults();
+     } while (nvsl::MicroBenchmarkHarness::NextSweepPoint());
 
      for (unsigned int i = 0; i < argsList.size(); i++)
 	free(argsList[i]->buf);
 
-     return 0;
+     return nvsl::MicroBenchmarkHarness::GetExitStatus();
 }
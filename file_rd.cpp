@@ -52,6 +52,12 @@ void ParseOptions(int & argc, char  *argv[])
           }
      }
 
+     // Record our options so they show up in the results.
+     nvsl::MicroBenchmarkHarness::RecordOption("path", filepath);
+     nvsl::MicroBenchmarkHarness::RecordOption("random", randomRead);
+     nvsl::MicroBenchmarkHarness::RecordOption("picked", nvsl::MicroBenchmarkHarness::IsDistributionSet());
+     nvsl::MicroBenchmarkHarness::RecordOption("fileBytes", fileLength);
+     nvsl::MicroBenchmarkHarness::RecordOption("blockBytes", blockSize);
 }
 
 // Little struct with the state our benchmark needs in each thread.
@@ -62,15 +68,9 @@ struct ThreadArgs {
      int fd;
      uint64_t readSize;
      uint64_t fileSize;
+     char * buf;
 };
 
-// Barriers to coordinate execution across threads.  The main goal is to make
-// sure that some threads don't start running before all of them have been
-// created.
-nvsl::Barrier *startBarrier;
-nvsl::Barrier *endBarrier;
-nvsl::Barrier *runBarrier;
-
 long crunch(void *buf, long bufSize) {
      long sum = 0;
      register long *start = (long *)buf;
@@ -91,7 +91,10 @@ void read_forward(ThreadArgs * args) {
      fileSize = args->fileSize;
      readSize = args->readSize;
 
-     char *buf = (char *)valloc(readSize);
+     char *buf = args->buf;
+
+     // Every op covers the whole file, so start from the top.
+     lseek(args->fd, 0, SEEK_SET);
 
      while (fileSize > 0) {
 	if (readSize > fileSize)
@@ -104,8 +107,6 @@ void read_forward(ThreadArgs * args) {
 
         fileSize -= readSize;
     }
-
-    free(buf);
 }
 
 void read_backward(ThreadArgs * args) {
@@ -114,7 +115,7 @@ void read_backward(ThreadArgs * args) {
      fileSize = args->fileSize;
      readSize = args->readSize;
 
-     char *buf = (char *)valloc(readSize);
+     char *buf = args->buf;
 
      while (fileSize > 0) {
 	if (readSize > fileSize)
@@ -130,8 +131,21 @@ void read_backward(ThreadArgs * args) {
 
         fileSize -= readSize;
     }
+}
+
+// With -dist: as many block reads as the file has blocks, each at a
+// block the distribution picks, so hot blocks get read over and over.
+void read_picked(ThreadArgs * args) {
+     const nvsl::AccessDistribution & dist = nvsl::MicroBenchmarkHarness::GetDistribution();
+     uint64_t blocks = args->fileSize / args->readSize;
 
-    free(buf);
+     for (uint64_t i = 0; i < blocks; i++) {
+	off_t offset = static_cast<off_t>(dist.Pick(args->seed) * args->readSize);
+	if (pread(args->fd, args->buf, args->readSize, offset) <= 0)
+	    break;
+
+	(void)crunch(args->buf, args->readSize);
+    }
 }
 
 
@@ -142,50 +156,54 @@ void * go(void *arg) {
      // Recover this threads arguments.
      ThreadArgs * args = reinterpret_cast<ThreadArgs*>(arg);
 
-     // Grab the number of ops to perform per thread.
-     unsigned int threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread();
-
      void (*fptr)(ThreadArgs *);
-     if (randomRead)
+     if (nvsl::MicroBenchmarkHarness::IsDistributionSet())
+	fptr = &read_picked;
+     else if (randomRead)
 	fptr = &read_backward;
      else
 	fptr = &read_forward;
 
 
-     // Wait for the threads to be started.
-     startBarrier->Join();
+     // Run the warmup (if any) and each trial.  BeginTrial() waits for
+     // all the threads and starts the clock, and EndTrial() records the
+     // trial.
+     for(int trial = nvsl::MicroBenchmarkHarness::FirstTrial();
+	 trial < nvsl::MicroBenchmarkHarness::GetTrialCount();
+	 trial++) {
+	  nvsl::MicroBenchmarkHarness::BeginTrial(args->id, trial);
+
+	  // Grab the number of ops to perform per thread (the warmup has
+	  // its own count).
+	  unsigned long long threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread(args->id);
+
+	  //Go !
+	  if (nvsl::MicroBenchmarkHarness::GetOperationCount() == 0) { // Running for a fixed period of time.
+
+	       // isDone() checks a couple of termination conditions including
+	       while(!nvsl::MicroBenchmarkHarness::isDone()) {
+		    uint64_t start = nvsl::MicroBenchmarkHarness::OpStart(args->id);
+		    fptr(args);
+		    nvsl::MicroBenchmarkHarness::LatencyEnd(args->id, start);
+		    // Count each op as it finishes so -interval can see our
+		    // progress.  It's our own counter, so this is cheap.
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, 1);
+	       }
+	  } else { // running for a fixed number of ops.
+
+	       // Run the number of ops we should run.
+	       for(unsigned long long i = 0; i < threadOps; i++) {
+		    uint64_t start = nvsl::MicroBenchmarkHarness::OpStart(args->id);
+		    fptr(args);
+		    nvsl::MicroBenchmarkHarness::LatencyEnd(args->id, start);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, 1);
+	       }
 
-     // If you we are the first thread, start timing.
-     if (args->id == 0) {
-          nvsl::MicroBenchmarkHarness::StartTiming();
-     }
-
-     // ready, set, ....
-     runBarrier->Join();
-
-     //Go !
-     if (threadOps == 0) { // Running for a fixed period of time.
-
-	  uint64_t c = 0;
-	  // isDone() checks a couple of termination conditions including
-	  while(!nvsl::MicroBenchmarkHarness::isDone()) {
-	       fptr(args);
-	       c++;
 	  }
-	  // Tell the system how many operations we completed.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(c);
-     } else { // running for a fixed number of ops.
-
-	  // Run the number of ops we should run.
-	  for(unsigned int i = 0; i < threadOps; i++) {
-	       fptr(args);
-	  }
-	  // Tell the harness.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(threadOps);
 
+	  nvsl::MicroBenchmarkHarness::EndTrial(args->id, trial);
      }
 
-     endBarrier->Join();
      return NULL;
 }
 
@@ -202,46 +220,65 @@ int main (int argc, char *argv[]) {
      // parse our custom options
      ParseOptions(argc, argv);
 
-     // get thread count and create the barriers.
-     uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
-     startBarrier = new nvsl::Barrier(thread_count);
-     endBarrier = new nvsl::Barrier(thread_count);
-     runBarrier = new nvsl::Barrier(thread_count);
+     // Each op reads the whole file.  This is what -interval uses
+     // for bytesPerSec.
+     nvsl::MicroBenchmarkHarness::SetBytesPerOp(fileLength);
 
      typedef std::vector<ThreadArgs* > ArgsList;
 
-     ArgsList argsList;
-
      std::vector<int> fileDesc;
+     std::vector<char *> buffers;
 
      // Each thread will work on it's own file.
      // Open the file here if we are not interested in measuruing the open
-     // operation
-     for(unsigned int i= 0; i< thread_count; i++) {
-	ThreadArgs * t = new ThreadArgs;
+     // operation.  Open enough for the biggest -tc in a sweep, once.
+     // Read buffers too, from the harness so they're already faulted
+     // in (and on -pages pages) instead of allocated in every op.
+     for(unsigned int i= 0; i< nvsl::MicroBenchmarkHarness::GetMaxThreadCount(); i++) {
 	std::string fileName = filepath + patch::to_string(i+1);
-	int fd = open(fileName.c_str(), O_RDONLY);
-	t->max_index = nvsl::MicroBenchmarkHarness::GetFootPrintBytes()/sizeof(uint64_t)/thread_count;
-	t->seed = i;
-	t->id = i;
-	t->fd  = fd;
-	t->readSize = blockSize;
-	t->fileSize = fileLength;
-	argsList.push_back(t);
-	fileDesc.push_back(fd);
-     }
-
-     for(unsigned int i= 0; i< thread_count; i++) {
-          nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
+	fileDesc.push_back(open(fileName.c_str(), O_RDONLY));
+	// -cold drop drops it from the page cache before each trial.
+	nvsl::MicroBenchmarkHarness::AddColdFile(fileName);
+	buffers.push_back(reinterpret_cast<char *>(nvsl::MicroBenchmarkHarness::AllocateBuffer(blockSize)));
      }
 
-     // wait for all threads to complete.
-     nvsl::MicroBenchmarkHarness::WaitForThreads();
-     nvsl::MicroBenchmarkHarness::StopTiming();
-     nvsl::MicroBenchmarkHarness::PrintResults();
+     // Which blocks read_picked() reads (-dist).
+     nvsl::MicroBenchmarkHarness::GetDistribution().Build(std::max<uint64_t>(fileLength / blockSize, 1));
+
+     // Once for each -tc and -foot in the sweep.
+     do {
+	// get thread count.
+	uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
+
+	ArgsList argsList;
+
+	for(unsigned int i= 0; i< thread_count; i++) {
+	   ThreadArgs * t = new ThreadArgs;
+	   t->max_index = nvsl::MicroBenchmarkHarness::GetFootPrintBytes()/sizeof(uint64_t)/thread_count;
+	   t->seed = nvsl::MicroBenchmarkHarness::ThreadSeed(i);
+	   t->id = i;
+	   t->fd  = fileDesc[i];
+	   t->readSize = blockSize;
+	   t->fileSize = fileLength;
+	   t->buf = buffers[i];
+	   argsList.push_back(t);
+	}
+
+	for(unsigned int i= 0; i< thread_count; i++) {
+	     nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
+	}
+
+	// wait for all threads to complete.
+	nvsl::MicroBenchmarkHarness::WaitForThreads();
+	nvsl::MicroBenchmarkHarness::StopTiming();
+	nvsl::MicroBenchmarkHarness::PrintResults();
+
+	for (unsigned int i = 0; i < argsList.size(); i++)
+	   delete argsList[i];
+     } while (nvsl::MicroBenchmarkHarness::NextSweepPoint());
 
      for (unsigned int i = 0; i < fileDesc.size(); i++)
 	close(fileDesc[i]);
 
-     return 0;
+     return nvsl::MicroBenchmarkHarness::GetExitStatus();
 }
@@ -46,6 +46,11 @@ void ParseOptions(int & argc, char  *argv[])
                exit(EXIT_FAILURE);
           }
      }
+
+     // Record our options so they show up in the results.
+     nvsl::MicroBenchmarkHarness::RecordOption("path", filepath);
+     nvsl::MicroBenchmarkHarness::RecordOption("fileBytes", fileLength);
+     nvsl::MicroBenchmarkHarness::RecordOption("blockBytes", blockSize);
 }
 
 // Little struct with the state our benchmark needs in each thread.
@@ -59,13 +64,6 @@ struct ThreadArgs {
      char *buf;
 };
 
-// Barriers to coordinate execution across threads.  The main goal is to make
-// sure that some threads don't start running before all of them have been
-// created.
-nvsl::Barrier *startBarrier;
-nvsl::Barrier *endBarrier;
-nvsl::Barrier *runBarrier;
-
 void fill_buffer(ThreadArgs * args) {
      char rbyte = (char)RandLFSR(&args->seed) % args->max_index;
      char *buf  = args->buf;
@@ -82,6 +80,9 @@ void write_forward(ThreadArgs * args) {
 
      char *buf = args->buf;
 
+     // Every op covers the whole file, so start from the top.
+     lseek(args->fd, 0, SEEK_SET);
+
      while (fileSize > 0) {
 	if (writeSize > fileSize)
             writeSize = fileSize;
@@ -101,47 +102,49 @@ void * go(void *arg) {
      // Recover this threads arguments.
      ThreadArgs * args = reinterpret_cast<ThreadArgs*>(arg);
 
-     // Grab the number of ops to perform per thread.
-     unsigned int threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread();
-
      void (*fptr)(ThreadArgs *);
      fptr = &write_forward;
 
 
-     // Wait for the threads to be started.
-     startBarrier->Join();
-
-     // If you we are the first thread, start timing.
-     if (args->id == 0) {
-          nvsl::MicroBenchmarkHarness::StartTiming();
-     }
-
-     // ready, set, ....
-     runBarrier->Join();
-
-     //Go !
-     if (threadOps == 0) { // Running for a fixed period of time.
-
-	  uint64_t c = 0;
-	  // isDone() checks a couple of termination conditions including
-	  while(!nvsl::MicroBenchmarkHarness::isDone()) {
-	       fptr(args);
-	       c++;
-	  }
-	  // Tell the system how many operations we completed.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(c);
-     } else { // running for a fixed number of ops.
+     // Run the warmup (if any) and each trial.  BeginTrial() waits for
+     // all the threads and starts the clock, and EndTrial() records the
+     // trial.
+     for(int trial = nvsl::MicroBenchmarkHarness::FirstTrial();
+	 trial < nvsl::MicroBenchmarkHarness::GetTrialCount();
+	 trial++) {
+	  nvsl::MicroBenchmarkHarness::BeginTrial(args->id, trial);
+
+	  // Grab the number of ops to perform per thread (the warmup has
+	  // its own count).
+	  unsigned long long threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread(args->id);
+
+	  //Go !
+	  if (nvsl::MicroBenchmarkHarness::GetOperationCount() == 0) { // Running for a fixed period of time.
+
+	       // isDone() checks a couple of termination conditions including
+	       while(!nvsl::MicroBenchmarkHarness::isDone()) {
+		    uint64_t start = nvsl::MicroBenchmarkHarness::OpStart(args->id);
+		    fptr(args);
+		    nvsl::MicroBenchmarkHarness::LatencyEnd(args->id, start);
+		    // Count each op as it finishes so -interval can see our
+		    // progress.  It's our own counter, so this is cheap.
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, 1);
+	       }
+	  } else { // running for a fixed number of ops.
+
+	       // Run the number of ops we should run.
+	       for(unsigned long long i = 0; i < threadOps; i++) {
+		    uint64_t start = nvsl::MicroBenchmarkHarness::OpStart(args->id);
+		    fptr(args);
+		    nvsl::MicroBenchmarkHarness::LatencyEnd(args->id, start);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, 1);
+	       }
 
-	  // Run the number of ops we should run.
-	  for(unsigned int i = 0; i < threadOps; i++) {
-	       fptr(args);
 	  }
-	  // Tell the harness.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(threadOps);
 
+	  nvsl::MicroBenchmarkHarness::EndTrial(args->id, trial);
      }
 
-     endBarrier->Join();
      return NULL;
 }
 
@@ -158,11 +161,12 @@ int main (int argc, char *argv[]) {
      // parse our custom options
      ParseOptions(argc, argv);
 
-     // get thread count and create the barriers.
-     uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
-     startBarrier = new nvsl::Barrier(thread_count);
-     endBarrier = new nvsl::Barrier(thread_count);
-     runBarrier = new nvsl::Barrier(thread_count);
+     // Each op writes the whole file.  This is what -interval uses
+     // for bytesPerSec.
+     nvsl::MicroBenchmarkHarness::SetBytesPerOp(fileLength);
+
+     // Enough threads for the biggest -tc in a sweep.
+     uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetMaxThreadCount();
 
      typedef std::vector<ThreadArgs* > ArgsList;
 
@@ -172,14 +176,18 @@ int main (int argc, char *argv[]) {
 
      // Each thread will work on it's own file.
      // Open the file here if we are not interested in measuruing the open
-     // operation
+     // operation.  Files and buffers are set up once and shared by every
+     // point of a sweep.
      for(unsigned int i= 0; i< thread_count; i++) {
 	ThreadArgs * t = new ThreadArgs;
 	std::string fileName = filepath + patch::to_string(i+1);
 	int fd = open(fileName.c_str(), O_CREAT | O_WRONLY, 0600);
-	char *buf = (char *)valloc(blockSize);
+	// -cold drop writes it back and drops it before each trial.
+	nvsl::MicroBenchmarkHarness::AddColdFile(fileName);
+	// From the harness, so it's on -pages pages.
+	char *buf = (char *)nvsl::MicroBenchmarkHarness::AllocateBuffer(blockSize);
 	t->max_index = 255;
-	t->seed = i;
+	t->seed = nvsl::MicroBenchmarkHarness::ThreadSeed(i);
 	t->id = i;
 	t->fd  = fd;
 	t->writeSize = blockSize;
@@ -190,20 +198,20 @@ int main (int argc, char *argv[]) {
 	fileDesc.push_back(fd);
      }
 
-     for(unsigned int i= 0; i< thread_count; i++) {
-          nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
-     }
+     // Once for each -tc and -foot in the sweep.
+     do {
+	for(unsigned int i= 0; i< nvsl::MicroBenchmarkHarness::GetThreadCount(); i++) {
+	     nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
+	}
 
-     // wait for all threads to complete.
-     nvsl::MicroBenchmarkHarness::WaitForThreads();
-     nvsl::MicroBenchmarkHarness::StopTiming();
-     nvsl::MicroBenchmarkHarness::PrintResults();
+	// wait for all threads to complete.
+	nvsl::MicroBenchmarkHarness::WaitForThreads();
+	nvsl::MicroBenchmarkHarness::StopTiming();
+	nvsl::MicroBenchmarkHarness::PrintResults();
+     } while (nvsl::MicroBenchmarkHarness::NextSweepPoint());
 
      for (unsigned int i = 0; i < fileDesc.size(); i++)
 	close(fileDesc[i]);
 
-     for (unsigned int i = 0; i < argsList.size(); i++)
-	free(argsList[i]->buf);
-
-     return 0;
+     return nvsl::MicroBenchmarkHarness::GetExitStatus();
 }
@@ -0,0 +1,199 @@
+#include"MicroBenchmarkHarness.hpp"
+#include <vector>
+#include <string.h>
+#include "StreamKernels.hpp"
+
+
+/***
+
+    STREAM-style memory bandwidth.  Each thread splits its share of the
+    footprint into three arrays, a, b and c, and runs one of the kernels
+    in StreamKernels.hpp over them a block at a time, front to back and
+    around again.  Make -foot* several times the LLC to measure DRAM, or
+    smaller to measure the caches.
+
+    Every block is an op, and bytesPerSec counts the bytes of every
+    array the kernel touches (two blocks for copy and scale, three for
+    add and triad), the way STREAM does.  -k <kernel>[:<isa>] picks the
+    kernel (default triad, in the widest ISA this CPU has).
+
+***/
+
+
+// Custom options.
+
+std::string kernelName = "triad";
+nvsl::StreamKernel kernel;
+size_t block = 4096;
+
+// Parse our custom options on the command line.
+// k - kernel, as <name>[:<isa>]
+// b - block size: bytes of each array per op (like file_rd and file_wr's
+//     -b; the DAX benchmarks' -g is something else, their access size)
+void ParseOptions(int & argc, char  *argv[])
+{
+     int c;
+     /* process arguments */
+     while ((c = getopt(argc, argv, "k:b:")) != -1) {
+          switch (c) {
+	  case 'k':
+	       kernelName = optarg;
+	       break;
+	  case 'b':
+	       block = atoi(optarg);
+	       break;
+          default:
+               fprintf(stderr, "Illegal argument \"%c\"\n", c);
+               exit(EXIT_FAILURE);
+          }
+     }
+
+     if (!nvsl::FindStreamKernel(kernelName, kernel)) {
+	  fprintf(stderr, "Unknown kernel '%s'.  This CPU has %s\n", kernelName.c_str(),
+		  nvsl::StreamKernelNames().c_str());
+	  exit(EXIT_FAILURE);
+     }
+     if (block < nvsl::CacheLineBytes || block % nvsl::CacheLineBytes) {
+	  fprintf(stderr, "-b must be a multiple of %d\n", static_cast<int>(nvsl::CacheLineBytes));
+	  exit(EXIT_FAILURE);
+     }
+     // Each thread needs its own arrays.
+     if (nvsl::MicroBenchmarkHarness::IsFootprintShared()) {
+	  fprintf(stderr, "mem_bandwidth needs -footLayout private\n");
+	  exit(EXIT_FAILURE);
+     }
+
+     // Record our options so they show up in the results.
+     nvsl::MicroBenchmarkHarness::RecordOption("kernel", std::string(kernel.name) + ":" + kernel.isa);
+     nvsl::MicroBenchmarkHarness::RecordOption("blockB", block);
+}
+
+// Little struct with the state our benchmark needs in each thread.
+struct ThreadArgs {
+     char * a;
+     char * b;
+     char * c;
+     size_t arrayBytes;
+     size_t block;
+     size_t offset;
+     int id;
+};
+
+// Blocks between checks of isDone().
+#define BLOCKS 16
+
+// Run the kernel over the next block of each array.
+inline void Step(ThreadArgs * args) {
+     kernel.run(args->a + args->offset, args->b + args->offset, args->c + args->offset, args->block);
+     args->offset += args->block;
+     if (args->offset + args->block > args->arrayBytes) {
+	  args->offset = 0;
+     }
+}
+
+// The function each thread runs.  The argument gets passed from StartThread()
+// below.
+void * go(void *arg) {
+
+     // Recover this threads arguments.
+     ThreadArgs * args = reinterpret_cast<ThreadArgs*>(arg);
+
+     // Our share of the footprint, in three cache-line-aligned arrays,
+     // filled here, untimed, so the pages land where -numa says and the
+     // doubles are real numbers.
+     char * base = reinterpret_cast<char*>(nvsl::MicroBenchmarkHarness::GetFootprintBuffer(args->id));
+     size_t bytes = nvsl::MicroBenchmarkHarness::GetFootprintBufferBytes();
+     args->arrayBytes = bytes / 3 / nvsl::CacheLineBytes * nvsl::CacheLineBytes;
+     if (args->arrayBytes < nvsl::CacheLineBytes) {
+	  fprintf(stderr, "%llu B per thread is too small for three arrays\n",
+		  static_cast<unsigned long long>(bytes));
+	  exit(EXIT_FAILURE);
+     }
+     args->a = base;
+     args->b = base + args->arrayBytes;
+     args->c = base + 2 * args->arrayBytes;
+     args->block = std::min(block, args->arrayBytes);
+     args->offset = 0;
+     std::vector<double> ones(args->arrayBytes / sizeof(double), 1.0);
+     memcpy(args->a, &ones[0], args->arrayBytes);
+     memcpy(args->b, &ones[0], args->arrayBytes);
+     memcpy(args->c, &ones[0], args->arrayBytes);
+
+     // Warmup (if any) and trials.  BeginTrial() waits for the other
+     // threads and starts timing.
+     for(int trial = nvsl::MicroBenchmarkHarness::FirstTrial();
+	 trial < nvsl::MicroBenchmarkHarness::GetTrialCount();
+	 trial++) {
+	  nvsl::MicroBenchmarkHarness::BeginTrial(args->id, trial);
+
+	  if (nvsl::MicroBenchmarkHarness::GetOperationCount() == 0) { // Running for a fixed period of time.
+	       while(!nvsl::MicroBenchmarkHarness::isDone()) {
+		    for(int i = 0; i < BLOCKS; i++) {
+			 Step(args);
+		    }
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, BLOCKS);
+	       }
+	  } else { // running for a fixed number of blocks, counted as we go.
+	       uint64_t ops = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread(args->id);
+	       while (ops > 0) {
+		    uint64_t n = std::min<uint64_t>(ops, BLOCKS);
+		    for(uint64_t i = 0; i < n; i++) {
+			 Step(args);
+		    }
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, n);
+		    ops -= n;
+	       }
+	  }
+
+	  nvsl::MicroBenchmarkHarness::EndTrial(args->id, trial);
+     }
+     return NULL;
+}
+
+int main (int argc, char *argv[]) {
+
+     nvsl::MicroBenchmarkHarness::Init("memBandwidth", argc, argv);
+
+     nvsl::MicroBenchmarkHarness::SuspendTiming(); // Stop timing because we
+						   // are going set up some
+						   // stuff we don't want
+						   // timed.
+
+     // parse our custom options
+     ParseOptions(argc, argv);
+
+     // Once for each -tc and -foot in the sweep.
+     do {
+	  uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
+
+	  // Each op moves a block of every array the kernel touches.  The
+	  // block is clamped to the array size in go(), so do the same here.
+	  size_t arrayBytes = nvsl::MicroBenchmarkHarness::GetFootprintBufferBytes() / 3 /
+	       nvsl::CacheLineBytes * nvsl::CacheLineBytes;
+	  nvsl::MicroBenchmarkHarness::SetBytesPerOp(kernel.arrays * std::min(block, arrayBytes));
+
+	  std::vector<ThreadArgs *> argsList;
+	  for(unsigned int i = 0; i < thread_count; i++) {
+	       ThreadArgs * t = new ThreadArgs;
+	       memset(t, 0, sizeof(*t));
+	       t->id = i;
+	       argsList.push_back(t);
+	  }
+
+	  for(unsigned int i= 0; i< thread_count; i++) {
+	       nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
+	  }
+
+	  // wait for all threads to complete.
+	  nvsl::MicroBenchmarkHarness::WaitForThreads();
+	  nvsl::MicroBenchmarkHarness::StopTiming();
+	  nvsl::MicroBenchmarkHarness::PrintResults();
+
+	  for(unsigned int i = 0; i < thread_count; i++) {
+	       delete argsList[i];
+	  }
+     } while (nvsl::MicroBenchmarkHarness::NextSweepPoint());
+
+     // Nonzero if anything regressed against -baseline.
+     return nvsl::MicroBenchmarkHarness::GetExitStatus();
+}
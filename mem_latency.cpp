@@ -0,0 +1,261 @@
+#include"MicroBenchmarkHarness.hpp"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <vector>
+#include "FastRand.hpp"
+
+
+/***
+
+    Load-to-use latency by pointer chasing.  Each thread links the nodes
+    of its share of the footprint into one random cycle and follows it,
+    so every load depends on the one before and the prefetchers can't
+    guess the next address.  Sweep -foot* from a few KB to GBs to see L1,
+    L2, LLC and DRAM latency, or pass -file to chase through a mapped
+    file (e.g., on a DAX file system).
+
+    Every load is an op, so nsPerOp in the results is ns per load.  With
+    -c <chains>, each thread follows that many independent chains at
+    once, spread evenly around its cycle.  Their loads can overlap, so
+    nsPerOp at 1 chain over nsPerOp at N chains is how much memory-level
+    parallelism the machine finds.
+
+***/
+
+
+#define MAX_CHAINS 16
+
+// Custom options.
+
+unsigned int chains = 1;
+size_t stride = 64;
+
+// Parse our custom options on the command line.
+// c - independent chains per thread
+// s - bytes between nodes
+void ParseOptions(int & argc, char  *argv[])
+{
+     int c;
+     /* process arguments */
+     while ((c = getopt(argc, argv, "c:s:")) != -1) {
+          switch (c) {
+	  case 'c':
+	       chains = atoi(optarg);
+	       break;
+	  case 's':
+	       stride = atoi(optarg);
+	       break;
+          default:
+               fprintf(stderr, "Illegal argument \"%c\"\n", c);
+               exit(EXIT_FAILURE);
+          }
+     }
+
+     if (chains < 1 || chains > MAX_CHAINS) {
+	  fprintf(stderr, "-c must be 1 to %d\n", MAX_CHAINS);
+	  exit(EXIT_FAILURE);
+     }
+     if (stride < sizeof(char *) || stride % sizeof(char *)) {
+	  fprintf(stderr, "-s must be a multiple of %d\n", static_cast<int>(sizeof(char *)));
+	  exit(EXIT_FAILURE);
+     }
+     // Each thread needs its own part of the footprint to link up.
+     if (nvsl::MicroBenchmarkHarness::IsFootprintShared()) {
+	  fprintf(stderr, "mem_latency needs -footLayout private\n");
+	  exit(EXIT_FAILURE);
+     }
+
+     // Record our options so they show up in the results.
+     nvsl::MicroBenchmarkHarness::RecordOption("chains", chains);
+     nvsl::MicroBenchmarkHarness::RecordOption("stride", stride);
+}
+
+// Little struct with the state our benchmark needs in each thread.
+struct ThreadArgs {
+     char * base;
+     size_t bytes;
+     uint64_t seed;
+     int id;
+     char * heads[MAX_CHAINS];
+};
+
+// With -file, the mapped file.  Otherwise the harness's footprint arena.
+char * fileBase = NULL;
+
+// Link the nodes (stride bytes apart) in [base, base + bytes) into one
+// cycle in a random order, and start the chains evenly spaced around
+// it so they never run into each other.
+void BuildChains(ThreadArgs * args) {
+     uint64_t nodes = args->bytes / stride;
+     if (nodes < chains) {
+	  fprintf(stderr, "%llu B per thread is too small for %u chains of %llu B nodes\n",
+		  static_cast<unsigned long long>(args->bytes), chains, static_cast<unsigned long long>(stride));
+	  exit(EXIT_FAILURE);
+     }
+     std::vector<uint64_t> order(nodes);
+     for(uint64_t i = 0; i < nodes; i++) {
+	  order[i] = i;
+     }
+     // Fisher-Yates.
+     for(uint64_t i = nodes - 1; i > 0; i--) {
+	  uint64_t j = RandLFSR(&args->seed) % (i + 1);
+	  std::swap(order[i], order[j]);
+     }
+     for(uint64_t i = 0; i < nodes; i++) {
+	  char * node = args->base + order[i] * stride;
+	  *reinterpret_cast<char **>(node) = args->base + order[(i + 1) % nodes] * stride;
+     }
+     for(unsigned int c = 0; c < chains; c++) {
+	  args->heads[c] = args->base + order[c * nodes / chains] * stride;
+     }
+}
+
+// Take steps steps along each chain.  Chains is a template parameter so
+// the pointers live in registers and each step is just the loads.
+template<unsigned int Chains>
+void Chase(char ** heads, uint64_t steps) {
+     char * p[Chains];
+     for(unsigned int c = 0; c < Chains; c++) {
+	  p[c] = heads[c];
+     }
+     for(uint64_t s = 0; s < steps; s++) {
+	  for(unsigned int c = 0; c < Chains; c++) {
+	       p[c] = *reinterpret_cast<char **>(p[c]);
+	  }
+     }
+     for(unsigned int c = 0; c < Chains; c++) {
+	  heads[c] = p[c];
+     }
+}
+
+typedef void (ChaseFunction)(char **, uint64_t);
+ChaseFunction * chasers[MAX_CHAINS] = {
+     Chase<1>, Chase<2>, Chase<3>, Chase<4>, Chase<5>, Chase<6>, Chase<7>, Chase<8>,
+     Chase<9>, Chase<10>, Chase<11>, Chase<12>, Chase<13>, Chase<14>, Chase<15>, Chase<16>
+};
+
+// Steps between checks of isDone().
+#define STEPS 1024
+
+// The function each thread runs.  The argument gets passed from StartThread()
+// below.
+void * go(void *arg) {
+
+     // Recover this threads arguments.
+     ThreadArgs * args = reinterpret_cast<ThreadArgs*>(arg);
+
+     // Our share of the footprint, linked up here, untimed, so the pages
+     // land where -numa says.
+     if (fileBase != NULL) {
+	  args->bytes = nvsl::MicroBenchmarkHarness::GetFootprintBufferBytes();
+	  args->base = fileBase + args->id * args->bytes;
+     } else {
+	  args->base = reinterpret_cast<char*>(nvsl::MicroBenchmarkHarness::GetFootprintBuffer(args->id));
+	  args->bytes = nvsl::MicroBenchmarkHarness::GetFootprintBufferBytes();
+     }
+     BuildChains(args);
+     ChaseFunction * chase = chasers[chains - 1];
+
+     // Warmup (if any) and trials.  BeginTrial() waits for the other
+     // threads and starts timing (and with -cold, flushes what
+     // BuildChains() left in the caches first).
+     for(int trial = nvsl::MicroBenchmarkHarness::FirstTrial();
+	 trial < nvsl::MicroBenchmarkHarness::GetTrialCount();
+	 trial++) {
+	  nvsl::MicroBenchmarkHarness::BeginTrial(args->id, trial);
+
+	  if (nvsl::MicroBenchmarkHarness::GetOperationCount() == 0) { // Running for a fixed period of time.
+	       while(!nvsl::MicroBenchmarkHarness::isDone()) {
+		    chase(args->heads, STEPS);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, STEPS * chains);
+	       }
+	  } else { // running for a fixed number of loads.
+	       uint64_t loads = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread(args->id);
+	       uint64_t steps = loads / chains;
+	       while (steps > 0) {
+		    uint64_t n = std::min<uint64_t>(steps, STEPS);
+		    chase(args->heads, n);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, n * chains);
+		    steps -= n;
+	       }
+	       // The loads that don't make a step of every chain go on
+	       // chain 0 alone.
+	       uint64_t rest = loads % chains;
+	       if (rest > 0) {
+		    Chase<1>(args->heads, rest);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, rest);
+	       }
+	  }
+
+	  nvsl::MicroBenchmarkHarness::EndTrial(args->id, trial);
+     }
+     return NULL;
+}
+
+int main (int argc, char *argv[]) {
+
+     nvsl::MicroBenchmarkHarness::Init("memLatency", argc, argv);
+
+     nvsl::MicroBenchmarkHarness::SuspendTiming(); // Stop timing because we
+						   // are going set up some
+						   // stuff we don't want
+						   // timed.
+
+     // parse our custom options
+     ParseOptions(argc, argv);
+
+     // With -file, chase through the file instead of DRAM.  Map it once,
+     // big enough for the largest footprint in a sweep, split into
+     // slices the same way as the footprint arena.
+     std::string file = nvsl::MicroBenchmarkHarness::GetFileName();
+     if (file.size()) {
+	  size_t fileLen = std::max<size_t>(nvsl::MicroBenchmarkHarness::GetMaxFootPrintBytes(),
+					    nvsl::MicroBenchmarkHarness::GetMaxThreadCount() * nvsl::CacheLineBytes);
+	  int fd = open(file.c_str(), O_RDWR | O_CREAT, 0666);
+	  if (fd < 0 || ftruncate(fd, fileLen) != 0) {
+	       perror(file.c_str());
+	       exit(EXIT_FAILURE);
+	  }
+	  void * p = mmap(NULL, fileLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	  if (p == MAP_FAILED) {
+	       perror(file.c_str());
+	       exit(EXIT_FAILURE);
+	  }
+	  close(fd);
+	  fileBase = reinterpret_cast<char*>(p);
+	  // -cold clflush flushes it before each trial.
+	  nvsl::MicroBenchmarkHarness::AddColdRegion(fileBase, fileLen);
+     }
+
+     // Once for each -tc and -foot in the sweep.
+     do {
+	  uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
+
+	  std::vector<ThreadArgs *> argsList;
+	  for(unsigned int i = 0; i < thread_count; i++) {
+	       ThreadArgs * t = new ThreadArgs;
+	       t->base = NULL;
+	       t->bytes = 0;
+	       t->seed = nvsl::MicroBenchmarkHarness::ThreadSeed(i);
+	       t->id = i;
+	       argsList.push_back(t);
+	  }
+
+	  for(unsigned int i= 0; i< thread_count; i++) {
+	       nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
+	  }
+
+	  // wait for all threads to complete.
+	  nvsl::MicroBenchmarkHarness::WaitForThreads();
+	  nvsl::MicroBenchmarkHarness::StopTiming();
+	  nvsl::MicroBenchmarkHarness::PrintResults();
+
+	  for(unsigned int i = 0; i < thread_count; i++) {
+	       delete argsList[i];
+	  }
+     } while (nvsl::MicroBenchmarkHarness::NextSweepPoint());
+
+     // Nonzero if anything regressed against -baseline.
+     return nvsl::MicroBenchmarkHarness::GetExitStatus();
+}
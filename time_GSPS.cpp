@@ -35,6 +35,15 @@ void ParseOptions(int & argc, char  *argv[])
           }
      }
 
+     // -S is the same as the harness's -footLayout shared.
+     if (shared) {
+	  nvsl::MicroBenchmarkHarness::SetFootprintShared(true);
+     }
+     shared = nvsl::MicroBenchmarkHarness::IsFootprintShared();
+
+     // Record our options so they show up in the results.
+     nvsl::MicroBenchmarkHarness::RecordOption("shared", shared);
+     nvsl::MicroBenchmarkHarness::RecordOption("modulo", modulo);
 }
 
 // Little struct with the state our benchmark needs in each thread.
@@ -46,25 +55,37 @@ struct ThreadArgs {
 };
 
 
-// Barriers to coordinate execution across threads.  The main goal is to make
-// sure that some threads don't start running before all of them have been
-// created.
-nvsl::Barrier *startBarrier;
-nvsl::Barrier *endBarrier;
-nvsl::Barrier *runBarrier;
-
-
 // The core function we want to time.  In this case, we are swapping values in
-// a an array.
+// a an array, at indexes picked from -dist (uniform by default).
 void op(ThreadArgs * args) {
-     uint64_t a = RandLFSR(&args->seed) % args->max_index;
-     uint64_t b = RandLFSR(&args->seed) % args->max_index;
+     const nvsl::AccessDistribution & dist = nvsl::MicroBenchmarkHarness::GetDistribution();
+     uint64_t a = dist.Pick(args->seed);
+     uint64_t b = dist.Pick(args->seed);
      uint64_t t = args->data[a];
      args->data[a] = args->data[b];
      args->data[b] = t;
 }
 
 
+// Swaps between checks of isDone().
+#define SWAPS 64
+
+// Do n swaps.  Timed swaps wait for their turn with -rate and record
+// their latency with -lat.  That's two clock reads a swap, which is
+// more than the swap itself, so untimed runs leave it out.
+template<bool Timed>
+void Swaps(ThreadArgs * args, unsigned long long n) {
+     for(unsigned long long i = 0; i < n; i++) {
+	  if (Timed) {
+	       uint64_t start = nvsl::MicroBenchmarkHarness::OpStart(args->id);
+	       op(args);
+	       nvsl::MicroBenchmarkHarness::LatencyEnd(args->id, start);
+	  } else {
+	       op(args);
+	  }
+     }
+}
+
 // The function each threa runs.  The argument gets passed from StartThread()
 // below.  This is exactly what RunOps() does.
 void * go(void *arg) {
@@ -72,61 +93,86 @@ void * go(void *arg) {
      // Recover this threads arguments.
      ThreadArgs * args = reinterpret_cast<ThreadArgs*>(arg);
 
-     // Grab the number of ops to perform per thread.
-     unsigned int threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread();
+     // Get our array from the harness's footprint arena (the whole
+     // footprint if shared, our share of it otherwise).  The first call
+     // zeroes it, which faults it in here, untimed, by the thread that
+     // uses it, so its pages land where -numa says and are the size
+     // -pages asks for.
+     args->data = reinterpret_cast<uint64_t*>(nvsl::MicroBenchmarkHarness::GetFootprintBuffer(args->id));
+     args->max_index = nvsl::MicroBenchmarkHarness::GetFootprintBufferBytes()/sizeof(uint64_t);
+
+     // With -rate or -lat, every swap is timed.  Paced swaps go one at
+     // a time, so we stop on time instead of running a batch of them
+     // late once -rt is up.
+     bool timed = nvsl::MicroBenchmarkHarness::GetRate() > 0 || nvsl::MicroBenchmarkHarness::IsRecordingLatency();
+     void (*swaps)(ThreadArgs *, unsigned long long) = timed ? Swaps<true> : Swaps<false>;
+     unsigned long long batch = nvsl::MicroBenchmarkHarness::GetRate() > 0 ? 1 : SWAPS;
+
+     // Run the warmup (if any) and each trial.  BeginTrial() waits for
+     // all the threads (so none starts before they've all been
+     // created), starts the clock, notes when we got going
+     // (startSkewNs) and starts -counters.  With -cold, it first gets
+     // the array, which zeroing left in the cache, back out.
+     // EndTrial() stops our counters, notes when we finished (for
+     // -perthread, jainIndex, ...) and records the trial.
+     for(int trial = nvsl::MicroBenchmarkHarness::FirstTrial();
+	 trial < nvsl::MicroBenchmarkHarness::GetTrialCount();
+	 trial++) {
+	  nvsl::MicroBenchmarkHarness::BeginTrial(args->id, trial);
+
+	  // Grab the number of ops to perform per thread (the warmup has
+	  // its own count).
+	  unsigned long long threadOps = nvsl::MicroBenchmarkHarness::GetOperationCountPerThread(args->id);
+
+	  //Go !
+	  if (nvsl::MicroBenchmarkHarness::GetOperationCount() == 0) { // Running for a fixed period of time.
+
+	       // isDone() checks a couple of termination conditions including
+	       // whether we're out of time.  Tell the harness what we've done
+	       // every batch, so -interval sees our progress as we go.
+	       while(!nvsl::MicroBenchmarkHarness::isDone()) {
+		    swaps(args, batch);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, batch);
+	       }
+	  } else if (nvsl::MicroBenchmarkHarness::GetOperationChunk() > 0) { // -chunk: take ops from a shared pool.
+
+	       // Grab a chunk of ops at a time until they're all gone.
+	       unsigned long long n;
+	       while((n = nvsl::MicroBenchmarkHarness::ClaimOperations(nvsl::MicroBenchmarkHarness::GetOperationChunk())) > 0) {
+		    swaps(args, n);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, n);
+	       }
+	  } else { // running for a fixed number of ops.
+
+	       // Run the number of ops we should run, telling the harness as
+	       // we go.
+	       unsigned long long left = threadOps;
+	       while (left > 0) {
+		    unsigned long long n = std::min<unsigned long long>(left, batch);
+		    swaps(args, n);
+		    nvsl::MicroBenchmarkHarness::CompletedOperations(args->id, n);
+		    left -= n;
+	       }
 
-     // Wait for the threads to be started.
-     startBarrier->Join();
-
-     // If you we are the first thread, start timing.
-     if (args->id == 0) {
-          nvsl::MicroBenchmarkHarness::StartTiming();
-     }
-
-     // ready, set, ....
-     runBarrier->Join();
-
-     //Go !
-     if (threadOps == 0) { // Running for a fixed period of time.
-	  
-	  uint64_t c = 0;
-	  // isDone() checks a couple of termination conditions including 
-	  while(!nvsl::MicroBenchmarkHarness::isDone()) {
-	       op(args);
-	       c++;
 	  }
-	  // Tell the system how many operations we completed.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(c);
-     } else { // running for a fixed number of ops.
-
-	  // Run the number of ops we should run.
-	  for(unsigned int i = 0; i < threadOps; i++) {
-	       op(args);
-	  }
-	  // Tell the harness.
-	  nvsl::MicroBenchmarkHarness::CompletedOperations(threadOps);
 
+	  nvsl::MicroBenchmarkHarness::EndTrial(args->id, trial);
      }
 
-     // The above implementation may not be a deal.  if the latency for op() is
-     // variable, we may end up waiting for a slow thread to finish, which will
-     // effectively reduce our throughput.
-     //
-     // An alternative implementation would look like this:
+     // Splitting the ops evenly up front may not be a good deal.  If the
+     // latency for op() is variable, we may end up waiting for a slow thread
+     // to finish, which will effectively reduce our throughput.
      //
-     // while(!nvsl::MicroBenchmarkHarness::isDone()) {
-     //     op(args);
-     //     nvsl::MicroBenchmarkHarness::CompletedOperations(1);
-     // }
+     // That's what -chunk is for: instead of a fixed share, each thread
+     // claims ops from a shared pool, chunk ops at a time, so a slow thread
+     // just ends up doing fewer of them.  Claiming touches a shared
+     // variable, which is expensive if op() is fast, so make the chunk big
+     // enough that it doesn't happen often.
      //
-     // This will work since isDone() also checks the operation count and will
-     // return true once we have executed enough ops.  The problem is that
-     // CompletedOperations() has to increment a shared variable and that turns
-     // out to be expensive if op() is fast.
-     //
-     // The right approach depends on your op().
+     // CompletedOperations(id, n) counts ops in a per-thread counter on its
+     // own cache line, so calling it often is cheap.  The right chunk size
+     // depends on your op().
      
-     endBarrier->Join();
      return NULL;
 }
 
@@ -143,49 +189,44 @@ int main (int argc, char *argv[]) {
      // parse our custom options
      ParseOptions(argc, argv);
 
-     // get thread count and create the barriers.
-     uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
-     startBarrier = new nvsl::Barrier(thread_count);
-     endBarrier = new nvsl::Barrier(thread_count);
-     runBarrier = new nvsl::Barrier(thread_count);
+     // -tc and -foot can be lists, so everything that depends on
+     // them goes in a loop that runs once per combination.
+     do {
+	  uint32_t thread_count = nvsl::MicroBenchmarkHarness::GetThreadCount();
+
+	  // Every thread's array has the same number of elements.
+	  nvsl::MicroBenchmarkHarness::GetDistribution().Build(nvsl::MicroBenchmarkHarness::GetFootprintBufferBytes()/sizeof(uint64_t));
 
-     typedef std::vector<ThreadArgs* > ArgsList;
+	  typedef std::vector<ThreadArgs* > ArgsList;
      
-     ArgsList argsList;
+	  ArgsList argsList;
 
-     // If shared, then all the threads work on the same array.
-     if (shared) {
-	  ThreadArgs *p = new ThreadArgs;
-	  p->max_index = nvsl::MicroBenchmarkHarness::GetFootPrintBytes()/sizeof(uint64_t);
-	  p->data = new uint64_t[p->max_index];
-	  p->seed = 1;
+	  // Each thread gets its array in go().  If shared, they all work
+	  // on the same one.
 	  for(unsigned int i = 0; i < thread_count; i++) {
 	       ThreadArgs * t = new ThreadArgs;
-	       t->max_index = p->max_index;
-	       t->data = p->data;
-	       t->seed = i;
+	       t->data = NULL;
+	       t->max_index = 0;
+	       t->seed = nvsl::MicroBenchmarkHarness::ThreadSeed(i);
 	       t->id = i;
 	       argsList.push_back(t);
 	  }
-     } else { // no shared, they get their own array.
-	  for(unsigned int i = 0; i < thread_count; i++) {
-	       ThreadArgs * t = new ThreadArgs;
-	       t->max_index = nvsl::MicroBenchmarkHarness::GetFootPrintBytes()/sizeof(uint64_t)/thread_count;
-	       t->data = new uint64_t[t->max_index];
-	       t->seed = i;
-	       t->id = i;
-	       argsList.push_back(t);
-	  }
-     }
      
-     for(unsigned int i= 0; i< thread_count; i++) {
-          nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
-     }
+	  for(unsigned int i= 0; i< thread_count; i++) {
+	       nvsl::MicroBenchmarkHarness::StartThread(go,reinterpret_cast<void*>(argsList[i]));
+	  }
+
+	  // wait for all threads to complete.
+	  nvsl::MicroBenchmarkHarness::WaitForThreads();
+	  nvsl::MicroBenchmarkHarness::StopTiming();
+	  nvsl::MicroBenchmarkHarness::PrintResults();
 
-     // wait for all threads to complete.
-     nvsl::MicroBenchmarkHarness::WaitForThreads();
-     nvsl::MicroBenchmarkHarness::StopTiming();
-     nvsl::MicroBenchmarkHarness::PrintResults();
+	  // Clean up for the next point.
+	  for(unsigned int i = 0; i < thread_count; i++) {
+	       delete argsList[i];
+	  }
+     } while (nvsl::MicroBenchmarkHarness::NextSweepPoint());
 
-     return 0;
+     // Nonzero if anything regressed against -baseline.
+     return nvsl::MicroBenchmarkHarness::GetExitStatus();
 }
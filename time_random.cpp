@@ -1,26 +1,185 @@
 #include"MicroBenchmarkHarness.hpp"
 #include <unistd.h>
+#include <sstream>
+#include <vector>
 #include "FastRand.hpp"
 
-// functions that perfoms the operation we want to measure.  This function
-// needs to be stateless aside from arg and seed, since any static or global
-// variables it uses will be shared across all the threads.
+// Times the generators in FastRand.hpp, each as its own phase (and row
+// in the results).  An op fills a buffer of -b random numbers, one call
+// at a time ("lfsr", "wyrand", ...) or with one batch Fill() that steps
+// RAND_LANES streams at once ("lfsr-batch", ...), so the rows compare
+// directly and bytesPerSec / 8 is numbers per second.  With -b 1, the
+// one-call rows time a single call per op.
 
-void op(int id, void *arg, uint64_t & seed) {
-     RandLFSR(&seed);
+enum Generator {
+     LFSR,
+     XorShift128Plus,
+     SplitMix,
+     Wy,
+     Generators
+};
+const char * generatorNames[Generators] = {"lfsr", "xorshift128+", "splitmix64", "wyrand"};
+typedef void (FillFunction)(RandLanes &, uint64_t *, size_t);
+FillFunction * fills[Generators] = {RandLFSR64Fill, RandXorShift128PlusFill, SplitMix64Fill, RandWyFill};
+
+// Custom options.
+
+std::vector<Generator> generators;
+std::string generatorList = "all";
+size_t batch = 1024;
+
+// Parse our custom options on the command line.
+// g - generators to time (comma separated, default all)
+// b - random numbers per op
+void ParseOptions(int & argc, char  *argv[])
+{
+     int c;
+     /* process arguments */
+     while ((c = getopt(argc, argv, "g:b:")) != -1) {
+          switch (c) {
+	  case 'g': {
+		generatorList = optarg;
+		std::stringstream names(generatorList);
+		std::string name;
+		while (std::getline(names, name, ',')) {
+		     int g = 0;
+		     while (g < Generators && name != generatorNames[g]) {
+			  g++;
+		     }
+		     if (g == Generators) {
+			  fprintf(stderr, "Unknown generator '%s' (lfsr, xorshift128+, splitmix64 or wyrand)\n", name.c_str());
+			  exit(EXIT_FAILURE);
+		     }
+		     generators.push_back(static_cast<Generator>(g));
+		}
+		break;
+	  }
+	  case 'b':
+	       batch = atoi(optarg);
+	       if (batch < 1) {
+		    fprintf(stderr, "-b must be at least 1\n");
+		    exit(EXIT_FAILURE);
+	       }
+	       break;
+          default:
+               fprintf(stderr, "Illegal argument \"%c\"\n", c);
+               exit(EXIT_FAILURE);
+          }
+     }
+     if (generators.empty()) {
+	  for(int g = 0; g < Generators; g++) {
+	       generators.push_back(static_cast<Generator>(g));
+	  }
+     }
+
+     // Record our options so they show up in the results.
+     nvsl::MicroBenchmarkHarness::RecordOption("generators", generatorList);
+     nvsl::MicroBenchmarkHarness::RecordOption("batch", batch);
+}
+
+// Each thread's generators and buffer, on cache lines of their own.
+struct alignas(64) ThreadState {
+     uint64_t xorshift[2];
+     uint64_t splitmix;
+     uint64_t wy;
+     RandLanes lanes;
+     std::vector<uint64_t> buffer;
+};
+std::vector<ThreadState> states;
+FillFunction * fill;
+
+// Fill the buffer one call at a time.  The state is copied to a local
+// first, since it could alias the buffer as far as the compiler knows.
+template<class G>
+inline void FillByCalls(uint64_t * out, uint64_t & state, G next) {
+     uint64_t s = state;
+     for(size_t i = 0; i < batch; i++) {
+	  out[i] = next(s);
+     }
+     state = s;
+}
+
+// Run op as phase name.
+template<class F>
+void Time(const std::string & name, const F & op) {
+     nvsl::MicroBenchmarkHarness::BeginPhase(name);
+     nvsl::MicroBenchmarkHarness::RunOps(op);
+     nvsl::MicroBenchmarkHarness::EndPhase();
 }
 
 int main(int argc, char *argv[]) {
      // The first argument is an identifier for this micro benchmark.  This will be the first field of the output.
-     nvsl::MicroBenchmarkHarness::Init("RandLFSR", argc, argv);
+     nvsl::MicroBenchmarkHarness::Init("rand", argc, argv);
+
+     // parse our custom options
+     ParseOptions(argc, argv);
+     nvsl::MicroBenchmarkHarness::SetBytesPerOp(batch * sizeof(uint64_t));
+
+     // RunOps() runs each op repeatedly with the number of threads and for
+     // the length of time specified via command line args.
+     //
+     // RunOps(op, NULL) would work too, but it calls op() through a function
+     // pointer and checks isDone() after every call, which costs about as
+     // much as RandLFSR() itself.  Passing a lambda lets the compiler inline
+     // op() and run it in unrolled batches between checks.
+     //
+     // If -tc or -foot is a list, do it (and print a result) for each
+     // combination.
+     do {
+	  states.clear();
+	  states.resize(nvsl::MicroBenchmarkHarness::GetThreadCount());
+	  for(unsigned int i = 0; i < states.size(); i++) {
+	       uint64_t seed = nvsl::MicroBenchmarkHarness::ThreadSeed(i);
+	       RandSeedXorShift128Plus(states[i].xorshift, seed);
+	       states[i].splitmix = seed;
+	       states[i].wy = seed;
+	       RandSeedLanes(states[i].lanes, seed);
+	       states[i].buffer.resize(batch);
+	  }
+
+	  for(unsigned int g = 0; g < generators.size(); g++) {
+	       std::string name = generatorNames[generators[g]];
+	       switch (generators[g]) {
+	       case LFSR:
+		    // The harness's own per-thread seed is an LFSR state.
+		    Time(name, [](int id, uint64_t & seed) {
+			      FillByCalls(&states[id].buffer[0], seed, [](uint64_t & s) {return RandLFSR(&s);});
+			 });
+		    break;
+	       case XorShift128Plus:
+		    Time(name, [](int id, uint64_t & seed) {
+			      ThreadState & t = states[id];
+			      uint64_t s[2] = {t.xorshift[0], t.xorshift[1]};
+			      for(size_t i = 0; i < batch; i++) {
+				   t.buffer[i] = RandXorShift128Plus(s);
+			      }
+			      t.xorshift[0] = s[0];
+			      t.xorshift[1] = s[1];
+			 });
+		    break;
+	       case SplitMix:
+		    Time(name, [](int id, uint64_t & seed) {
+			      FillByCalls(&states[id].buffer[0], states[id].splitmix, [](uint64_t & s) {return SplitMix64(&s);});
+			 });
+		    break;
+	       case Wy:
+		    Time(name, [](int id, uint64_t & seed) {
+			      FillByCalls(&states[id].buffer[0], states[id].wy, [](uint64_t & s) {return RandWy(&s);});
+			 });
+		    break;
+	       default:
+		    break;
+	       }
 
-     // If you need parse command line args, do it here.
+	       fill = fills[generators[g]];
+	       Time(name + "-batch", [](int id, uint64_t & seed) {
+			 fill(states[id].lanes, &states[id].buffer[0], batch);
+		    });
+	  }
 
-     // This will run op() repeatedly with the number of threads and for the lengt of time specifiied via command line args.
-     nvsl::MicroBenchmarkHarness::RunOps(op, NULL);
+	  // Dump results.
+	  nvsl::MicroBenchmarkHarness::PrintResults(std::cout);
+     } while (nvsl::MicroBenchmarkHarness::NextSweepPoint());
 
-     // Dump results.
-     nvsl::MicroBenchmarkHarness::PrintResults(std::cout);
-     
-     return 0;
+     return nvsl::MicroBenchmarkHarness::GetExitStatus();
 }
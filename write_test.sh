@@ -2,7 +2,7 @@
 
 ## USAGE 
 ## bash write_test.sh <number of iterations> [block_size]
-## Default is 16 threads, 5 iterations
+## Default is 16 threads, 5 iterations (trials, in one process)
 
 k=$1
 
@@ -19,7 +19,5 @@ fi
 
 
 for t in {1,2,4,6,8,12,16}; do
-    for i in $(seq 1 $k); do
-	./file_wr.exe tc$t-size2GB-block$b -tc $t -max $t -b $b
-    done;
+    ./file_wr.exe tc$t-size2GB-block$b -tc $t -max $t -b $b -trials $k
 done